@@ -0,0 +1,48 @@
+/**
+ * @file cell_list.cpp
+ * @brief Cell grid of a periodic box for neighbor searches
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "cell_list.h"
+
+void CellList::setGrid(const FrameBox& box, double cutoff, size_t natoms) {
+    // the planes of lattice vector k are 1 / |row k of the inverse| apart, cells are
+    // made slightly wider than cutoff so rounding of fractions cannot hide a pair
+    for (int k = 0; k < 3; k++) {
+        const double* row = box.inverse + 3 * k;
+        double width = 1.0 / sqrt(row[0] * row[0] + row[1] * row[1] + row[2] * row[2]);
+        double cells = floor(width / (cutoff * (1 + 1e-9)));
+        n_[k] = static_cast<int>(std::min(std::max(cells, 1.0), 1024.0));
+    }
+
+    // far more cells than atoms only costs memory, coarser cells stay correct
+    while (static_cast<size_t>(n_[0]) * n_[1] * n_[2] > 4 * natoms + 27) {
+        int* largest = std::max_element(n_, n_ + 3);
+        *largest = std::max(1, *largest / 2);
+    }
+
+    for (int k = 0; k < 3; k++) {
+        lo_[k] = n_[k] >= 3 ? -1 : 0;
+        hi_[k] = n_[k] >= 3 ? 1 : n_[k] - 1;
+    }
+}
+
+void CellList::sortAtoms(const std::vector<int>& atoms) {
+    size_t ncells = static_cast<size_t>(n_[0]) * n_[1] * n_[2];
+    start_.assign(ncells + 1, 0);
+    for (int cell : cell_of_) {
+        start_[cell + 1]++;
+    }
+    for (size_t cell = 0; cell < ncells; cell++) {
+        start_[cell + 1] += start_[cell];
+    }
+
+    // counting sort, atoms keep their input order within a cell
+    atoms_.resize(atoms.size());
+    std::vector<int> next(start_.begin(), start_.end() - 1);
+    for (size_t i = 0; i < atoms.size(); i++) {
+        atoms_[next[cell_of_[i]]++] = atoms[i];
+    }
+}
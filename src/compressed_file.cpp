@@ -0,0 +1,365 @@
+/**
+ * @file compressed_file.cpp
+ * @brief gzip and zstd decompression of input files
+ *
+ * gzip is decoded with zlib. zstd support is compiled in when the zstd library
+ * is found at configure time, MDTOOLS_HAVE_ZSTD is then defined in MDToolsConfig.h.
+ */
+
+#include <stdexcept>
+#include <cstring>
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include <zlib.h>
+#include "MDToolsConfig.h"
+#ifdef MDTOOLS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "compressed_file.h"
+
+namespace {
+
+const size_t INPUT_BLOCK_SIZE = 1 << 22;    // Compressed bytes read per block
+const size_t OUTPUT_BLOCK_SIZE = 1 << 22;   // Decompressed bytes handed to InputFile per block
+
+void checkZstdSupport() {
+#ifndef MDTOOLS_HAVE_ZSTD
+    throw std::runtime_error("zstd compressed input needs MDTools built with the zstd library.");
+#endif
+}
+
+/**
+ * @brief Inflates a complete gzip file, including concatenated members
+ */
+std::vector<char> inflateAll(const char* data, size_t size) {
+    // the trailer holds the uncompressed size of the last member modulo 2^32
+    size_t guess = size * 4;
+    if (size >= 4) {
+        uint32_t trailer;
+        memcpy(&trailer, data + size - 4, 4);
+        guess = std::max(guess, static_cast<size_t>(trailer));
+    }
+    std::vector<char> output(guess);
+
+    z_stream stream{};
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        throw std::runtime_error("Cannot initialise gzip decompression.");
+    }
+
+    // a member may be followed by another one, the last must be complete
+    size_t in = 0, out = 0;
+    bool member_end = false;
+    while (!member_end || in < size) {
+        if (member_end) {
+            inflateReset(&stream);
+            member_end = false;
+        }
+        if (out == output.size()) {
+            output.resize(output.size() * 2);
+        }
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + in));
+        stream.avail_in = static_cast<uInt>(std::min<size_t>(size - in, UINT_MAX));
+        stream.next_out = reinterpret_cast<Bytef*>(output.data() + out);
+        stream.avail_out = static_cast<uInt>(std::min<size_t>(output.size() - out, UINT_MAX));
+        uInt avail_in = stream.avail_in, avail_out = stream.avail_out;
+
+        int status = inflate(&stream, Z_NO_FLUSH);
+        in += avail_in - stream.avail_in;
+        out += avail_out - stream.avail_out;
+
+        if (status == Z_STREAM_END) {
+            member_end = true;
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            inflateEnd(&stream);
+            throw std::runtime_error("Corrupt gzip input.");
+        } else if (avail_in == stream.avail_in && avail_out == stream.avail_out) {
+            inflateEnd(&stream);
+            throw std::runtime_error("Truncated gzip input.");
+        }
+    }
+    inflateEnd(&stream);
+    output.resize(out);
+    return output;
+}
+
+#ifdef MDTOOLS_HAVE_ZSTD
+/**
+ * @brief Decompresses a complete zstd file, frames in parallel when their sizes are known
+ */
+std::vector<char> zstdAll(const char* data, size_t size) {
+    std::vector<size_t> in_offsets, in_sizes, out_offsets;
+    size_t total = 0;
+    bool sizes_known = true;
+    for (size_t pos = 0; pos < size;) {
+        size_t frame_size = ZSTD_findFrameCompressedSize(data + pos, size - pos);
+        if (ZSTD_isError(frame_size)) {
+            throw std::runtime_error(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(frame_size));
+        }
+        unsigned long long content = ZSTD_getFrameContentSize(data + pos, frame_size);
+        if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR) {
+            sizes_known = false;
+        } else {
+            in_offsets.push_back(pos);
+            in_sizes.push_back(frame_size);
+            out_offsets.push_back(total);
+            total += content;
+        }
+        pos += frame_size;
+    }
+
+    std::vector<char> output;
+    if (sizes_known) {
+        output.resize(total);
+        int nframes = static_cast<int>(in_offsets.size());
+        std::vector<std::string> errors(nframes);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int f = 0; f < nframes; f++) {
+            size_t content = (f + 1 < nframes ? out_offsets[f + 1] : total) - out_offsets[f];
+            size_t written = ZSTD_decompress(output.data() + out_offsets[f], content,
+                                             data + in_offsets[f], in_sizes[f]);
+            if (ZSTD_isError(written)) {
+                errors[f] = ZSTD_getErrorName(written);
+            } else if (written != content) {
+                errors[f] = "frame size mismatch";
+            }
+        }
+
+        for (const std::string& error : errors) {
+            if (!error.empty()) {
+                throw std::runtime_error("Corrupt zstd input: " + error);
+            }
+        }
+        return output;
+    }
+
+    // frames without a recorded size are streamed into a growing buffer
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    output.resize(size * 4);
+    ZSTD_inBuffer in{data, size, 0};
+    size_t out = 0;
+    size_t hint = 1;
+    while (in.pos < in.size || hint != 0) {
+        if (out == output.size()) {
+            output.resize(output.size() * 2);
+        }
+        ZSTD_outBuffer buffer{output.data(), output.size(), out};
+        size_t in_before = in.pos;
+        hint = ZSTD_decompressStream(stream, &buffer, &in);
+        if (ZSTD_isError(hint)) {
+            ZSTD_freeDStream(stream);
+            throw std::runtime_error(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(hint));
+        }
+        if (in.pos == in_before && buffer.pos == out && in.pos == in.size) {
+            ZSTD_freeDStream(stream);
+            throw std::runtime_error("Truncated zstd input.");
+        }
+        out = buffer.pos;
+    }
+    ZSTD_freeDStream(stream);
+    output.resize(out);
+    return output;
+}
+#endif
+
+} // namespace
+
+Compression detectCompression(const char* data, size_t size) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+        return Compression::gzip;
+    }
+    if (size >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) {
+        return Compression::zstd;
+    }
+    return Compression::none;
+}
+
+Compression fileCompression(const std::string& filename) {
+    char magic[4];
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        return Compression::none;
+    }
+    size_t size = std::fread(magic, 1, sizeof(magic), file);
+    std::fclose(file);
+    return detectCompression(magic, size);
+}
+
+std::vector<char> decompress(const char* data, size_t size, Compression compression) {
+    if (compression == Compression::gzip) {
+        return inflateAll(data, size);
+    }
+    checkZstdSupport();
+#ifdef MDTOOLS_HAVE_ZSTD
+    return zstdAll(data, size);
+#else
+    return {};
+#endif
+}
+
+struct DecompressingReader::Decoder {
+    z_stream zlib{};
+    bool member_end{false};                 // gzip member finished, next one may follow
+#ifdef MDTOOLS_HAVE_ZSTD
+    ZSTD_DStream* zstd{nullptr};
+    size_t hint{0};                         // 0 once a zstd frame is complete
+#endif
+};
+
+DecompressingReader::DecompressingReader(const std::string& filename) {
+    file_ = std::fopen(filename.c_str(), "rb");
+    if (!file_) {
+        return;
+    }
+
+    // the magic bytes are the start of the first input block
+    input_.resize(INPUT_BLOCK_SIZE);
+    refill();
+    compression_ = detectCompression(input_.data(), input_end_);
+
+    decoder_ = std::make_unique<Decoder>();
+    try {
+        if (compression_ == Compression::gzip && inflateInit2(&decoder_->zlib, 15 + 16) != Z_OK) {
+            compression_ = Compression::none;
+            throw std::runtime_error("Cannot initialise gzip decompression.");
+        }
+        if (compression_ == Compression::zstd) {
+            checkZstdSupport();
+#ifdef MDTOOLS_HAVE_ZSTD
+            decoder_->zstd = ZSTD_createDStream();
+#endif
+        }
+    } catch (...) {
+        std::fclose(file_);
+        throw;
+    }
+}
+
+DecompressingReader::~DecompressingReader() {
+    if (decoder_ && compression_ == Compression::gzip) {
+        inflateEnd(&decoder_->zlib);
+    }
+#ifdef MDTOOLS_HAVE_ZSTD
+    if (decoder_ && decoder_->zstd) {
+        ZSTD_freeDStream(decoder_->zstd);
+    }
+#endif
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+void DecompressingReader::refill() {
+    if (input_begin_ < input_end_ || input_eof_) {
+        return;
+    }
+    input_begin_ = 0;
+    input_end_ = std::fread(input_.data(), 1, input_.size(), file_);
+    if (input_end_ == 0) {
+        if (std::ferror(file_)) {
+            throw std::runtime_error("Error while reading input file.");
+        }
+        input_eof_ = true;
+    }
+}
+
+size_t DecompressingReader::read(char* buffer, size_t size) {
+    if (!file_) {
+        return 0;
+    }
+
+    // plain files hand out the buffered block, then read directly
+    if (compression_ == Compression::none) {
+        size_t produced = std::min(size, input_end_ - input_begin_);
+        memcpy(buffer, input_.data() + input_begin_, produced);
+        input_begin_ += produced;
+        if (produced < size) {
+            produced += std::fread(buffer + produced, 1, size - produced, file_);
+            if (std::ferror(file_)) {
+                throw std::runtime_error("Error while reading input file.");
+            }
+        }
+        bytes_read_ += produced;
+        return produced;
+    }
+
+    size_t produced = 0;
+    while (produced < size) {
+        refill();
+        bool input_left = input_begin_ < input_end_;
+        size_t before = produced;
+
+        if (compression_ == Compression::gzip) {
+            z_stream& stream = decoder_->zlib;
+            if (decoder_->member_end) {
+                if (!input_left) {
+                    break;
+                }
+                inflateReset(&stream);
+                decoder_->member_end = false;
+            }
+            stream.next_in = reinterpret_cast<Bytef*>(input_.data() + input_begin_);
+            stream.avail_in = static_cast<uInt>(input_end_ - input_begin_);
+            stream.next_out = reinterpret_cast<Bytef*>(buffer + produced);
+            stream.avail_out = static_cast<uInt>(std::min<size_t>(size - produced, UINT_MAX));
+            uInt avail_out = stream.avail_out;
+
+            int status = inflate(&stream, Z_NO_FLUSH);
+            input_begin_ = input_end_ - stream.avail_in;
+            produced += avail_out - stream.avail_out;
+            if (status == Z_STREAM_END) {
+                decoder_->member_end = true;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                throw std::runtime_error("Corrupt gzip input.");
+            }
+            if (!input_left && produced == before && !decoder_->member_end) {
+                throw std::runtime_error("Truncated gzip input.");
+            }
+        } else {
+#ifdef MDTOOLS_HAVE_ZSTD
+            if (!input_left && decoder_->hint == 0) {
+                break;
+            }
+            ZSTD_inBuffer in{input_.data(), input_end_, input_begin_};
+            ZSTD_outBuffer out{buffer, size, produced};
+            decoder_->hint = ZSTD_decompressStream(decoder_->zstd, &out, &in);
+            if (ZSTD_isError(decoder_->hint)) {
+                throw std::runtime_error(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(decoder_->hint));
+            }
+            input_begin_ = in.pos;
+            produced = out.pos;
+            if (!input_left && produced == before && decoder_->hint != 0) {
+                throw std::runtime_error("Truncated zstd input.");
+            }
+#endif
+        }
+    }
+    bytes_read_ += produced;
+    return produced;
+}
+
+InputFile::InputFile(const std::string& filename)
+    : std::istream(nullptr), reader_(filename), buffer_(reader_) {
+    rdbuf(&buffer_);
+    if (!reader_.isOpen()) {
+        setstate(std::ios::failbit);
+    }
+}
+
+InputFile::Buffer::Buffer(DecompressingReader& reader)
+    : reader_(reader), block_(OUTPUT_BLOCK_SIZE) {
+}
+
+InputFile::Buffer::int_type InputFile::Buffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    size_t bytes = reader_.read(block_.data(), block_.size());
+    if (bytes == 0) {
+        return traits_type::eof();
+    }
+    setg(block_.data(), block_.data(), block_.data() + bytes);
+    return traits_type::to_int_type(*gptr());
+}
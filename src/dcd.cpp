@@ -0,0 +1,300 @@
+/**
+ * @file dcd.cpp
+ * @brief CHARMM / NAMD / X-PLOR DCD trajectory reading
+ *
+ * A DCD file is a sequence of Fortran unformatted records: a header with the
+ * control block, a title block and the number of atoms, optionally the list of
+ * free atoms, then per frame an optional unit cell record and one record each of
+ * x, y and z coordinates in single precision. Frames are decoded straight from
+ * the mapped file, so selected frames are reached by seeking and read in parallel.
+ */
+
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "topology.h"
+#include "dcd.h"
+#include "system.h"
+
+namespace {
+
+/**
+ * @brief Reads a value stored at p, swapping bytes if the file byte order differs
+ */
+template <typename T>
+T readValue(const char* p, bool swap) {
+    char bytes[sizeof(T)];
+    if (swap) {
+        std::reverse_copy(p, p + sizeof(T), bytes);
+    } else {
+        memcpy(bytes, p, sizeof(T));
+    }
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+int32_t byteSwapped(int32_t value) {
+    return readValue<int32_t>(reinterpret_cast<const char*>(&value), true);
+}
+
+const int CONTROL_BLOCK_SIZE = 84;          // "CORD" followed by 20 control integers
+
+} // namespace
+
+DCDFile::DCDFile(const std::string& filename, bool sequential) : map_(filename, sequential) {
+    // the first record holds 84 bytes, which gives byte order and marker size
+    if (map_.size() < 8) {
+        throw std::runtime_error("DCD file " + filename + " is too short.");
+    }
+    int32_t first;
+    int64_t first_long;
+    memcpy(&first, map_.data(), sizeof(first));
+    memcpy(&first_long, map_.data(), sizeof(first_long));
+    if (first == CONTROL_BLOCK_SIZE || byteSwapped(first) == CONTROL_BLOCK_SIZE) {
+        swap_ = first != CONTROL_BLOCK_SIZE;
+    } else if (first_long == CONTROL_BLOCK_SIZE
+               || readValue<int64_t>(map_.data(), true) == CONTROL_BLOCK_SIZE) {
+        swap_ = first_long != CONTROL_BLOCK_SIZE;
+        marker_size_ = 8;
+    } else {
+        throw std::runtime_error("File " + filename + " is not a DCD trajectory.");
+    }
+
+    size_t offset = 0;
+    checkMarker(offset, CONTROL_BLOCK_SIZE);
+    offset += marker_size_;
+    if (memcmp(map_.data() + offset, "CORD", 4) != 0) {
+        throw std::runtime_error("DCD file " + filename + " does not hold coordinates.");
+    }
+    int32_t control[20];
+    for (int i = 0; i < 20; i++) {
+        control[i] = readValue<int32_t>(map_.data() + offset + 4 + 4 * i, swap_);
+    }
+    int header_frames = control[0];
+    nfixed_ = control[8];
+    bool charmm = control[19] != 0;
+    has_cell_ = charmm && control[10] != 0;
+    has_4d_ = charmm && control[11] != 0;
+    offset += CONTROL_BLOCK_SIZE;
+    checkMarker(offset, CONTROL_BLOCK_SIZE);
+    offset += marker_size_;
+
+    // title block, skipped
+    uint64_t title_size = marker(offset);
+    checkMarker(offset + marker_size_ + title_size, title_size);
+    offset += 2 * marker_size_ + title_size;
+
+    checkMarker(offset, 4);
+    natoms_ = readValue<int32_t>(map_.data() + offset + marker_size_, swap_);
+    checkMarker(offset + marker_size_ + 4, 4);
+    offset += 2 * marker_size_ + 4;
+    if (natoms_ <= 0 || nfixed_ < 0 || nfixed_ >= natoms_) {
+        throw std::runtime_error("Invalid number of atoms in DCD header.");
+    }
+
+    // 1 based indices of the free atoms, whose coordinates later frames store
+    if (nfixed_ > 0) {
+        int nfree = natoms_ - nfixed_;
+        checkMarker(offset, 4ULL * nfree);
+        free_slots_.assign(natoms_, -1);
+        for (int k = 0; k < nfree; k++) {
+            int atom = readValue<int32_t>(map_.data() + offset + marker_size_ + 4 * k, swap_) - 1;
+            if (atom < 0 || atom >= natoms_) {
+                throw std::runtime_error("Invalid free atom index in DCD header.");
+            }
+            free_slots_[atom] = k;
+        }
+        offset += 2 * marker_size_ + 4ULL * nfree;
+    }
+
+    first_offset_ = offset;
+    first_size_ = frameSize(natoms_);
+    frame_size_ = frameSize(natoms_ - nfixed_);
+    nframes_ = map_.size() < first_offset_ + first_size_ ? 0
+               : 1 + static_cast<int>((map_.size() - first_offset_ - first_size_) / frame_size_);
+    if (nframes_ == 0) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+    if (header_frames != 0 && header_frames != nframes_) {
+        std::cerr << "DCD header lists " << header_frames << " frames, the file holds "
+                  << nframes_ << " complete frames." << std::endl;
+    }
+
+    if (nfixed_ > 0) {
+        std::vector<int> all(natoms_);
+        for (int j = 0; j < natoms_; j++) {
+            all[j] = j;
+        }
+        fixed_coords_.resize(static_cast<size_t>(natoms_) * 3);
+        readFrame(0, all, fixed_coords_.data(), nullptr);
+    }
+}
+
+uint64_t DCDFile::marker(size_t offset) const {
+    if (offset + marker_size_ > map_.size()) {
+        throw std::runtime_error("DCD file is truncated.");
+    }
+    if (marker_size_ == 8) {
+        return readValue<uint64_t>(map_.data() + offset, swap_);
+    }
+    return readValue<uint32_t>(map_.data() + offset, swap_);
+}
+
+void DCDFile::checkMarker(size_t offset, uint64_t length) const {
+    if (marker(offset) != length) {
+        throw std::runtime_error("Corrupt DCD record at byte " + std::to_string(offset) + ".");
+    }
+}
+
+size_t DCDFile::frameSize(int ncoords) const {
+    size_t cell_size = has_cell_ ? 2 * marker_size_ + 6 * sizeof(double) : 0;
+    size_t axis_size = 2 * marker_size_ + static_cast<size_t>(ncoords) * sizeof(float);
+    return cell_size + (has_4d_ ? 4 : 3) * axis_size;
+}
+
+size_t DCDFile::frameOffset(int frame) const {
+    return frame == 0 ? first_offset_ : first_offset_ + first_size_ + (frame - 1) * frame_size_;
+}
+
+void DCDFile::readFrame(int frame, const std::vector<int>& indices, double* coords, double* box) const {
+    if (frame < 0 || frame >= nframes_) {
+        throw std::out_of_range("Frame " + std::to_string(frame) + " is not in the DCD trajectory.");
+    }
+
+    size_t offset = frameOffset(frame);
+    if (has_cell_) {
+        checkMarker(offset, 6 * sizeof(double));
+        if (box) {
+            // CHARMM order a, gamma, b, beta, alpha, c; newer writers store angle cosines
+            const char* p = map_.data() + offset + marker_size_;
+            double cell[6];
+            for (int k = 0; k < 6; k++) {
+                cell[k] = readValue<double>(p + k * sizeof(double), swap_);
+            }
+            double angles[3] = {cell[4], cell[3], cell[1]};
+            bool cosines = std::all_of(angles, angles + 3, [](double x) { return std::fabs(x) <= 1.0; });
+            box[0] = cell[0];
+            box[1] = cell[2];
+            box[2] = cell[5];
+            for (int k = 0; k < 3; k++) {
+                box[3 + k] = cosines ? std::acos(angles[k]) * 180.0 / M_PI : angles[k];
+            }
+        }
+        offset += 2 * marker_size_ + 6 * sizeof(double);
+    }
+
+    bool all_atoms = frame == 0 || nfixed_ == 0;
+    int ncoords = all_atoms ? natoms_ : natoms_ - nfixed_;
+    const char* axes[3];
+    for (int k = 0; k < 3; k++) {
+        if (marker(offset) != 4ULL * ncoords) {
+            throw std::runtime_error("Corrupt coordinate record in DCD frame " + std::to_string(frame) + ".");
+        }
+        axes[k] = map_.data() + offset + marker_size_;
+        offset += 2 * marker_size_ + 4ULL * ncoords;
+    }
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        int slot = all_atoms ? indices[i] : free_slots_[indices[i]];
+        for (int k = 0; k < 3; k++) {
+            coords[i * 3 + k] = slot < 0 ? fixed_coords_[indices[i] * 3 + k]
+                                         : readValue<float>(axes[k] + 4 * slot, swap_);
+        }
+    }
+}
+
+DCDFrameSource::DCDFrameSource(const std::string& filename, const std::vector<std::string>& names,
+                               const FrameSelection& selection, const AtomSelection& atom_selection)
+    : file_(filename), selection_(selection) {
+    if (static_cast<int>(names.size()) != file_.natoms()) {
+        throw std::runtime_error("Topology has " + std::to_string(names.size()) + " atoms, DCD trajectory has "
+                                 + std::to_string(file_.natoms()) + ".");
+    }
+    atom_selection.slots(names, indices_);
+    for (int index : indices_) {
+        names_.push_back(names[index]);
+    }
+}
+
+bool DCDFrameSource::readFrame(double* coords, double* box) {
+    int frame = selection_.trajectoryFrame(count_);
+    if (frame >= file_.nframes() || selection_.finished(frame)) {
+        return false;
+    }
+    if (box && !file_.hasUnitCell()) {
+        throw std::runtime_error("DCD trajectory has no unit cell records, a box file is required.");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    file_.readFrame(frame, indices_, coords, box);
+    count_++;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    read_seconds_ += elapsed.count();
+    return true;
+}
+
+void System::readDCD(const std::string& filename, const std::string& topology_file_name, int threads) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+    if (topology_file_name.empty()) {
+        throw std::runtime_error("DCD trajectories need a topology_input naming the atoms.");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "Reading DCD trajectory file: " << filename << std::endl;
+    std::vector<std::string> trajectory_atoms = readAtomNames(topology_file_name);
+    DCDFile dcd(filename);
+    if (static_cast<int>(trajectory_atoms.size()) != dcd.natoms()) {
+        throw std::runtime_error("Topology has " + std::to_string(trajectory_atoms.size())
+                                 + " atoms, DCD trajectory has " + std::to_string(dcd.natoms()) + ".");
+    }
+
+    std::vector<int> frames;
+    for (int frame = selection.begin; frame < dcd.nframes() && !selection.finished(frame); frame += selection.stride) {
+        frames.push_back(frame);
+    }
+    if (frames.empty()) {
+        throw std::logic_error("No frames in the requested range, the trajectory has "
+                               + std::to_string(dcd.nframes()) + " frames.");
+    }
+
+    nframes = static_cast<int>(frames.size());
+    setupAtoms(trajectory_atoms);
+
+    // unit cells take the place of the xyz comment line boxes
+    xyz_boxes.clear();
+    xyz_box_error.clear();
+    if (dcd.hasUnitCell()) {
+        xyz_boxes.resize(static_cast<size_t>(nframes) * 6);
+    } else {
+        xyz_box_error = "DCD trajectory has no unit cell records.";
+    }
+
+    std::vector<std::string> errors(nframes);
+    #pragma omp parallel for schedule(static) num_threads(std::max(1, threads))
+    for (int i = 0; i < nframes; i++) {
+        try {
+            double* frame_coords = frameBuffer(i);
+            dcd.readFrame(frames[i], atom_indices, frame_coords,
+                          dcd.hasUnitCell() ? &xyz_boxes[static_cast<size_t>(i) * 6] : nullptr);
+            storeFrame(i, frame_coords);
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+    }
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reportThroughput(dcd.size(), elapsed.count());
+    std::cout << "Trajectory file parsed successfully!" << std::endl;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file extxyz.cpp
+ * @brief Extended xyz comment line keys
+ *
+ * Extended xyz files, as written by ASE and others, keep key=value pairs in
+ * the comment line. Lattice gives the cell vectors, Properties the meaning of
+ * the atom line columns.
+ */
+
+#include <stdexcept>
+#include <cstring>
+#include "text_scan.h"
+#include "extxyz.h"
+
+namespace {
+
+/**
+ * @brief Finds key= at the start of a token, case insensitively
+ *
+ * @return Start of the value, nullptr if the key is absent
+ */
+const char* findKey(const char* p, const char* eol, const char* key) {
+    size_t length = strlen(key);
+    for (const char* q = p; q + length < eol; q++) {
+        if ((q == p || *(q - 1) == ' ' || *(q - 1) == '\t') && q[length] == '='
+            && strncasecmp(q, key, length) == 0) {
+            return q + length + 1;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+bool parseLattice(const char* p, const char* eol, double* matrix) {
+    const char* value = findKey(p, eol, "Lattice");
+    if (!value) {
+        return false;
+    }
+
+    const char* value_end = eol;
+    if (value < eol && *value == '"') {
+        value++;
+        value_end = static_cast<const char*>(memchr(value, '"', eol - value));
+        if (!value_end) {
+            throw std::runtime_error("Unterminated Lattice value in extended xyz comment line.");
+        }
+    }
+
+    double vectors[9];
+    for (int k = 0; k < 9; k++) {
+        value = value ? textscan::parseDouble(value, value_end, vectors[k]) : nullptr;
+    }
+    if (!value) {
+        throw std::runtime_error("Lattice needs 9 numbers in extended xyz comment line.");
+    }
+
+    // the value lists a, b and c, the box matrix holds them as columns
+    for (int v = 0; v < 3; v++) {
+        for (int r = 0; r < 3; r++) {
+            matrix[3 * r + v] = vectors[3 * v + r];
+        }
+    }
+    return true;
+}
+
+bool parseProperties(const char* p, const char* eol, XYZColumns& columns, std::vector<AtomProperty>& properties) {
+    columns = XYZColumns();
+    properties.clear();
+    const char* value = findKey(p, eol, "Properties");
+    if (!value) {
+        return false;
+    }
+
+    const char* token;
+    size_t length;
+    textscan::parseToken(value, eol, token, length);
+    std::string spec(token, length);
+
+    // triplets of name, type and count separated by colons
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t colon = spec.find(':', start);
+        fields.push_back(spec.substr(start, colon == std::string::npos ? std::string::npos : colon - start));
+        if (colon == std::string::npos) {
+            break;
+        }
+        start = colon + 1;
+    }
+    if (fields.size() % 3 != 0) {
+        throw std::runtime_error("Invalid Properties value in extended xyz comment line: " + spec);
+    }
+
+    columns.species = -1;
+    columns.pos = -1;
+    int column = 0;
+    for (size_t f = 0; f < fields.size(); f += 3) {
+        const std::string& name = fields[f];
+        const std::string& type = fields[f + 1];
+        int count = std::atoi(fields[f + 2].c_str());
+        if (count <= 0 || type.size() != 1 || std::string("RISL").find(type) == std::string::npos) {
+            throw std::runtime_error("Invalid Properties value in extended xyz comment line: " + spec);
+        }
+
+        if (name == "species" && type == "S" && count == 1) {
+            columns.species = column;
+        } else if (name == "pos" && type == "R" && count == 3) {
+            columns.pos = column;
+        } else if (type == "R" || type == "I") {
+            properties.push_back(AtomProperty{name, count, column, {}});
+        }
+        column += count;
+    }
+    columns.ncolumns = column;
+
+    if (columns.species < 0 || columns.pos < 0) {
+        throw std::runtime_error("Properties need species:S:1 and pos:R:3 in extended xyz comment line.");
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file frame_box.cpp
+ * @brief Box matrices, volumes and inverses of periodic boxes
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include "frame_box.h"
+
+void boxMatrixFromParameters(const double* params, double* matrix) {
+    double PI = 3.141592653589793238L;
+    double radian_to_degree = PI / 180;
+
+    matrix[0] = params[0];
+    matrix[1] = params[1] * cos(params[5] * radian_to_degree);
+    matrix[2] = params[2] * cos(params[4] * radian_to_degree);
+    matrix[3] = 0;
+    matrix[4] = params[1] * sin(params[5] * radian_to_degree);
+    matrix[5] = (params[1] * params[2] * cos(params[3] * radian_to_degree)
+                 - matrix[1] * matrix[2]) / matrix[4];
+    matrix[6] = 0;
+    matrix[7] = 0;
+    matrix[8] = sqrt(params[2] * params[2] - matrix[2] * matrix[2] - matrix[5] * matrix[5]);
+}
+
+FrameBox makeFrameBox(const double* matrix) {
+    FrameBox box{};
+    std::copy(matrix, matrix + 9, box.matrix);
+
+    box.volume = 0;
+    for (int i = 0; i < 3; i++) {
+        box.volume += matrix[i] *
+                      (matrix[3 + (i + 1) % 3] * matrix[6 + (i + 2) % 3] -
+                       matrix[3 + (i + 2) % 3] * matrix[6 + (i + 1) % 3]);
+    }
+    if (box.volume <= 0) {
+        throw std::logic_error("PBC box volume should be positive!");
+    }
+
+    // adjugate over determinant
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            box.inverse[i * 3 + j] = ((matrix[3 * ((j + 1) % 3) + (i + 1) % 3] *
+                                       matrix[3 * ((j + 2) % 3) + (i + 2) % 3]) -
+                                      (matrix[3 * ((j + 1) % 3) + (i + 2) % 3] *
+                                       matrix[3 * ((j + 2) % 3) + (i + 1) % 3]))
+                                     / box.volume;
+        }
+    }
+
+    // 90 degree angles leave cos(90) * length, about 1e-16 of the diagonal
+    double scale = std::max({fabs(matrix[0]), fabs(matrix[4]), fabs(matrix[8])});
+    box.orthorhombic = true;
+    for (int k : {1, 2, 3, 5, 6, 7}) {
+        box.orthorhombic = box.orthorhombic && fabs(matrix[k]) <= 1e-12 * scale;
+    }
+    return box;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file frame_index.cpp
+ * @brief Frame offset index sidecar files
+ *
+ * Reading and writing of the byte offsets of trajectory frames. The index is
+ * built by FrameIndex::buildXYZ in xyz.cpp, FrameIndex::buildXTC in xtc.cpp
+ * or recorded during the first parse.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <cstring>
+#include "mapped_file.h"
+#include "topology.h"
+#include "frame_index.h"
+
+namespace {
+
+struct IndexHeader {
+    char magic[8];                      // "MDTINDEX"
+    uint32_t version;
+    int32_t natoms;
+    uint64_t nframes;
+    uint64_t source_size;
+    int64_t source_mtime;
+};
+
+constexpr uint32_t INDEX_VERSION = 1;
+
+} // namespace
+
+void FrameIndex::build(const std::string& trajectory_file_name) {
+    if (hasExtension(trajectory_file_name, ".xtc")) {
+        buildXTC(trajectory_file_name);
+    } else {
+        buildXYZ(trajectory_file_name);
+    }
+}
+
+bool FrameIndex::read(const std::string& index_file_name, const std::string& trajectory_file_name) {
+    std::ifstream file(index_file_name, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    IndexHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || memcmp(header.magic, "MDTINDEX", 8) != 0 || header.version != INDEX_VERSION) {
+        std::cerr << "Frame index " << index_file_name << " has an unknown format, rebuilding it." << std::endl;
+        return false;
+    }
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    fileStamp(trajectory_file_name, source_size, source_mtime);
+    if (header.source_size != source_size || header.source_mtime != source_mtime) {
+        std::cout << "Frame index " << index_file_name << " is stale, rebuilding it." << std::endl;
+        return false;
+    }
+
+    // the offsets fill the rest of the file, checked before nframes sizes anything
+    std::error_code ec;
+    uint64_t index_size = std::filesystem::file_size(index_file_name, ec);
+    if (ec || (index_size - sizeof(header)) / sizeof(uint64_t) != header.nframes) {
+        std::cerr << "Frame index " << index_file_name << " is truncated, rebuilding it." << std::endl;
+        return false;
+    }
+
+    natoms = header.natoms;
+    offsets.resize(header.nframes);
+    if (!file.read(reinterpret_cast<char*>(offsets.data()), header.nframes * sizeof(uint64_t))) {
+        std::cerr << "Frame index " << index_file_name << " is truncated, rebuilding it." << std::endl;
+        offsets.clear();
+        return false;
+    }
+    return true;
+}
+
+void FrameIndex::write(const std::string& index_file_name, const std::string& trajectory_file_name) const {
+    IndexHeader header{};
+    memcpy(header.magic, "MDTINDEX", 8);
+    header.version = INDEX_VERSION;
+    header.natoms = natoms;
+    header.nframes = offsets.size();
+    fileStamp(trajectory_file_name, header.source_size, header.source_mtime);
+
+    // written under a temporary name so a crash never leaves a valid looking index
+    std::string temporary_name = index_file_name + ".tmp";
+    std::ofstream file(temporary_name, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    file.close();
+
+    std::error_code ec;
+    if (file) {
+        std::filesystem::rename(temporary_name, index_file_name, ec);
+    }
+    if (!file || ec) {
+        std::cerr << "Cannot write frame index " << index_file_name << ", continuing without." << std::endl;
+        std::filesystem::remove(temporary_name, ec);
+        return;
+    }
+    std::cout << "Frame index written: " << index_file_name << " (" << offsets.size() << " frames)" << std::endl;
+}
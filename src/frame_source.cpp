@@ -0,0 +1,126 @@
+/**
+ * @file frame_source.cpp
+ * @brief Background prefetching of trajectory frames
+ *
+ * A producer thread reads frames into a ring of buffers while the RDF
+ * calculation consumes earlier frames, overlapping I/O with computation.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include "frame_source.h"
+
+bool AtomSelection::keeps(const std::string& name) const {
+    return std::find(species.begin(), species.end(), name) != species.end();
+}
+
+std::vector<int> AtomSelection::slots(const std::vector<std::string>& names, std::vector<int>& indices) const {
+    std::vector<int> slot(names.size(), -1);
+    indices.clear();
+    for (size_t j = 0; j < names.size(); j++) {
+        if (!active() || keeps(names[j])) {
+            slot[j] = static_cast<int>(indices.size());
+            indices.push_back(static_cast<int>(j));
+        }
+    }
+    return slot;
+}
+
+PrefetchFrameSource::PrefetchFrameSource(std::unique_ptr<FrameSource> inner, int depth)
+    : inner_(std::move(inner)), slots_(std::max(1, depth)) {
+    for (Slot& slot : slots_) {
+        slot.coords.resize(static_cast<size_t>(inner_->natoms()) * 3);
+    }
+}
+
+PrefetchFrameSource::~PrefetchFrameSource() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    slot_freed_.notify_all();
+    if (producer_.joinable()) {
+        producer_.join();
+    }
+}
+
+void PrefetchFrameSource::produce() {
+    while (true) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            slot_freed_.wait(lock, [this] { return stop_ || filled_ < slots_.size(); });
+            if (stop_) {
+                return;
+            }
+            index = (head_ + filled_) % slots_.size();
+        }
+
+        // the slot is not visible to the caller until filled_ is increased
+        Slot& slot = slots_[index];
+        bool frame_read = false;
+        std::exception_ptr error;
+        auto start = std::chrono::steady_clock::now();
+        try {
+            frame_read = inner_->readFrame(slot.coords.data(), read_boxes_ ? slot.box : nullptr);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            read_seconds_ += elapsed.count();
+            if (frame_read) {
+                filled_++;
+            } else {
+                error_ = error;
+                done_ = true;
+            }
+        }
+        slot_filled_.notify_one();
+
+        if (!frame_read) {
+            return;
+        }
+    }
+}
+
+bool PrefetchFrameSource::readFrame(double* coords, double* box) {
+    if (!producer_.joinable()) {
+        read_boxes_ = (box != nullptr);
+        producer_ = std::thread(&PrefetchFrameSource::produce, this);
+    }
+
+    size_t index;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_filled_.wait(lock, [this] { return filled_ > 0 || done_; });
+        if (filled_ == 0) {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            return false;
+        }
+        index = head_;
+    }
+
+    const Slot& slot = slots_[index];
+    std::copy(slot.coords.begin(), slot.coords.end(), coords);
+    if (box) {
+        std::copy(slot.box, slot.box + boxSize(), box);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        head_ = (head_ + 1) % slots_.size();
+        filled_--;
+    }
+    slot_freed_.notify_one();
+    return true;
+}
+
+double PrefetchFrameSource::readSeconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return read_seconds_;
+}
@@ -0,0 +1,106 @@
+#ifndef CELL_LIST_H
+#define CELL_LIST_H
+#include <cmath>
+#include <vector>
+#include "frame_box.h"
+
+/**
+ * @class CellList
+ * @brief Bins atoms into cells of a periodic box for neighbor searches within a cutoff
+ *
+ * Cells divide the box along its lattice vectors, works for any triclinic box.
+ * Each cell is at least the cutoff wide perpendicular to its faces, so all atoms
+ * closer than the cutoff to a point, in any periodic image, lie in the cell of
+ * that point or in the adjacent ones. Boxes with fewer than 3 cells along a
+ * lattice vector visit each adjacent cell once, so no atom is reported twice.
+ */
+class CellList {
+public:
+    /**
+     * @brief Bins atoms by their fractional coordinates
+     *
+     * @param[in] box The box of the frame
+     * @param[in] cutoff The largest distance searched
+     * @param[in] atoms The atoms to bin
+     * @param[in] fraction fraction(atom, s) writes the 3 fractional coordinates of atom to s, in any image
+     */
+    template <typename Fraction>
+    void build(const FrameBox& box, double cutoff, const std::vector<int>& atoms, Fraction&& fraction) {
+        setGrid(box, cutoff, atoms.size());
+        cell_of_.resize(atoms.size());
+        for (size_t i = 0; i < atoms.size(); i++) {
+            double s[3];
+            fraction(atoms[i], s);
+            cell_of_[i] = cellIndex(s);
+        }
+        sortAtoms(atoms);
+    }
+
+    /**
+     * @brief Calls visit(atom) for every binned atom in the cell of s and the adjacent cells
+     *
+     * @param[in] s Fractional coordinates of the search center, in any image
+     */
+    template <typename Visit>
+    void forEachNeighbor(const double* s, Visit&& visit) const {
+        int c[3];
+        cellCoordinates(s, c);
+        for (int i = lo_[0]; i <= hi_[0]; i++) {
+            int x = wrap(c[0] + i, n_[0]);
+            for (int j = lo_[1]; j <= hi_[1]; j++) {
+                int y = wrap(c[1] + j, n_[1]);
+                for (int k = lo_[2]; k <= hi_[2]; k++) {
+                    int cell = (x * n_[1] + y) * n_[2] + wrap(c[2] + k, n_[2]);
+                    for (int m = start_[cell]; m < start_[cell + 1]; m++) {
+                        visit(atoms_[m]);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Number of cells along each lattice vector
+     */
+    const int* cells() const { return n_; }
+
+private:
+    int n_[3]{1, 1, 1};                 // Cells along each lattice vector
+    int lo_[3]{0, 0, 0};                // Cell offsets visited along each lattice vector
+    int hi_[3]{0, 0, 0};
+    std::vector<int> start_;            // First entry of each cell in atoms_, ncells + 1 entries
+    std::vector<int> atoms_;            // Binned atoms ordered by cell
+    std::vector<int> cell_of_;          // Cell of each binned atom, in input order
+
+    /**
+     * @brief Chooses the cells along each lattice vector for cutoff and natoms binned atoms
+     */
+    void setGrid(const FrameBox& box, double cutoff, size_t natoms);
+
+    /**
+     * @brief Orders atoms by cell_of_ into start_ and atoms_
+     */
+    void sortAtoms(const std::vector<int>& atoms);
+
+    static int wrap(int c, int n) {
+        return c < 0 ? c + n : (c >= n ? c - n : c);
+    }
+
+    void cellCoordinates(const double* s, int* c) const {
+        for (int k = 0; k < 3; k++) {
+            double w = s[k] - std::floor(s[k]);
+            c[k] = static_cast<int>(w * n_[k]);
+            if (c[k] >= n_[k]) {
+                c[k] = n_[k] - 1;
+            }
+        }
+    }
+
+    int cellIndex(const double* s) const {
+        int c[3];
+        cellCoordinates(s, c);
+        return (c[0] * n_[1] + c[1]) * n_[2] + c[2];
+    }
+};
+
+#endif // CELL_LIST_H
@@ -0,0 +1,126 @@
+#ifndef COMPRESSED_FILE_H
+#define COMPRESSED_FILE_H
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <istream>
+#include <streambuf>
+
+/**
+ * @brief Compression of an input file, recognised by its leading magic bytes
+ */
+enum class Compression { none, gzip, zstd };
+
+/**
+ * @brief Detects gzip and zstd data from the first bytes of a file
+ */
+Compression detectCompression(const char* data, size_t size);
+
+/**
+ * @brief Detects gzip and zstd files from their first bytes
+ *
+ * @return none also if the file cannot be opened
+ */
+Compression fileCompression(const std::string& filename);
+
+/**
+ * @brief Decompresses a whole gzip or zstd file held in memory
+ *
+ * zstd data made of several frames that record their content size, as written by
+ * pzstd or the zstd seekable format, is decompressed frame by frame in parallel.
+ * @param[in] data The compressed bytes
+ * @param[in] size The number of compressed bytes
+ * @param[in] compression The compression of data, not none
+ * @return The decompressed bytes
+ */
+std::vector<char> decompress(const char* data, size_t size, Compression compression);
+
+/**
+ * @class DecompressingReader
+ * @brief Reads a plain, gzip or zstd file sequentially, decompressing block by block
+ *
+ * Only one block of compressed input is held in memory, so files of any size can
+ * be read. Concatenated gzip members and zstd frames are read one after another.
+ */
+class DecompressingReader {
+public:
+    /**
+     * @brief Opens filename, isOpen() tells if that succeeded
+     */
+    explicit DecompressingReader(const std::string& filename);
+    ~DecompressingReader();
+    DecompressingReader(const DecompressingReader& other)              = delete;
+    DecompressingReader& operator = (const DecompressingReader& other) = delete;
+    DecompressingReader(DecompressingReader&& other)                   = delete;
+    DecompressingReader& operator = (DecompressingReader&& other)      = delete;
+
+    bool isOpen() const { return file_ != nullptr; }
+    Compression compression() const { return compression_; }
+
+    /**
+     * @brief Reads up to size decompressed bytes into buffer
+     *
+     * @return The number of bytes read, less than size only at the end of the file
+     */
+    size_t read(char* buffer, size_t size);
+
+    /**
+     * @brief The number of decompressed bytes read so far
+     */
+    size_t bytesRead() const { return bytes_read_; }
+
+private:
+    struct Decoder;
+
+    std::FILE* file_{nullptr};
+    Compression compression_{Compression::none};
+    std::vector<char> input_;               // Block of file bytes not yet decompressed
+    size_t input_begin_{0};
+    size_t input_end_{0};
+    bool input_eof_{false};
+    size_t bytes_read_{0};
+    std::unique_ptr<Decoder> decoder_;
+
+    /**
+     * @brief Reads the next block of the file once the previous one is used up
+     */
+    void refill();
+};
+
+/**
+ * @class InputFile
+ * @brief An std::istream over a plain, gzip or zstd file
+ *
+ * Drop-in for std::ifstream in the text readers, decompressed data is handed to
+ * the stream in large blocks.
+ */
+class InputFile : public std::istream {
+public:
+    explicit InputFile(const std::string& filename);
+
+    bool is_open() const { return reader_.isOpen(); }
+
+    /**
+     * @brief The number of decompressed bytes handed to the stream so far
+     */
+    size_t bytesRead() const { return reader_.bytesRead(); }
+
+private:
+    class Buffer : public std::streambuf {
+    public:
+        explicit Buffer(DecompressingReader& reader);
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        DecompressingReader& reader_;
+        std::vector<char> block_;
+    };
+
+    DecompressingReader reader_;
+    Buffer buffer_;
+};
+
+#endif // COMPRESSED_FILE_H
@@ -0,0 +1,101 @@
+#ifndef DCD_H
+#define DCD_H
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "frame_source.h"
+
+/**
+ * @class DCDFile
+ * @brief Random access to the frames of a CHARMM / NAMD / X-PLOR DCD trajectory
+ *
+ * The file is mapped and its header decoded once. Both byte orders and 4 or 8 byte
+ * Fortran record markers are recognised. All frames after the first have the same
+ * size, so any frame is reached by computing its offset. With fixed atoms only the
+ * free atoms are stored after the first frame, fixed atoms keep their first frame
+ * position. readFrame only reads the mapping and may be called concurrently.
+ */
+class DCDFile {
+public:
+    /**
+     * @param[in] filename The DCD trajectory
+     * @param[in] sequential Hint the kernel for sequential read ahead
+     */
+    explicit DCDFile(const std::string& filename, bool sequential = true);
+
+    int natoms() const { return natoms_; }
+    int nframes() const { return nframes_; }
+    size_t size() const { return map_.size(); }
+
+    /**
+     * @brief True if every frame carries a unit cell record
+     */
+    bool hasUnitCell() const { return has_cell_; }
+
+    /**
+     * @brief Reads the coordinates of some atoms of one frame
+     *
+     * @param[in] frame The frame index, 0 based
+     * @param[in] indices The trajectory index of each atom read
+     * @param[out] coords indices.size() * 3 coordinates
+     * @param[out] box The 6 box parameters (a, b, c, A, B, C) of the frame, or nullptr
+     */
+    void readFrame(int frame, const std::vector<int>& indices, double* coords, double* box) const;
+
+private:
+    MappedFile map_;
+    bool swap_{false};                      // File byte order differs from ours
+    int marker_size_{4};                    // Fortran record marker bytes
+    bool has_cell_{false};
+    bool has_4d_{false};
+    int natoms_{0};
+    int nfixed_{0};
+    int nframes_{0};
+    size_t first_offset_{0};                // Offset of frame 0
+    size_t first_size_{0};                  // Size of frame 0, holding all atoms
+    size_t frame_size_{0};                  // Size of every later frame
+    std::vector<int> free_slots_;           // Position of each atom in later frames, -1 if fixed
+    std::vector<double> fixed_coords_;      // Frame 0 coordinates when atoms are fixed
+
+    /**
+     * @brief Reads a record marker at offset and checks that it holds length
+     */
+    void checkMarker(size_t offset, uint64_t length) const;
+
+    uint64_t marker(size_t offset) const;
+    size_t frameSize(int ncoords) const;
+    size_t frameOffset(int frame) const;
+};
+
+/**
+ * @class DCDFrameSource
+ * @brief Streams the selected frames of a DCD trajectory by seeking to each frame
+ */
+class DCDFrameSource : public FrameSource {
+public:
+    /**
+     * @param[in] filename The DCD trajectory
+     * @param[in] names Atom names of the trajectory, from a topology
+     * @param[in] selection Frames read
+     * @param[in] atom_selection Atoms read
+     */
+    DCDFrameSource(const std::string& filename, const std::vector<std::string>& names,
+                   const FrameSelection& selection, const AtomSelection& atom_selection);
+
+    int natoms() const override { return static_cast<int>(indices_.size()); }
+    int natomsTotal() const override { return file_.natoms(); }
+    const std::vector<std::string>& atomNames() const override { return names_; }
+    const std::vector<int>& atomIndices() const override { return indices_; }
+    bool readFrame(double* coords, double* box) override;
+    double readSeconds() const override { return read_seconds_; }
+
+private:
+    DCDFile file_;
+    FrameSelection selection_;
+    std::vector<std::string> names_;
+    std::vector<int> indices_;
+    int count_{0};                          // Selected frames read so far
+    double read_seconds_{0.0};
+};
+
+#endif // DCD_H
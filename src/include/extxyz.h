@@ -0,0 +1,53 @@
+#ifndef EXTXYZ_H
+#define EXTXYZ_H
+#include <string>
+#include <vector>
+
+/**
+ * @struct AtomProperty
+ * @brief A numeric per-atom column of an extended xyz file, such as forces or velocities
+ */
+struct AtomProperty {
+    std::string name;
+    int size{1};                        // Values per atom
+    int column{0};                      // First column in the atom lines
+    std::vector<double> values;         // nframes * natoms * size values of the stored atoms
+};
+
+/**
+ * @struct XYZColumns
+ * @brief Layout of the atom lines of an xyz file, given by the Properties key of extended xyz
+ */
+struct XYZColumns {
+    int species{0};                     // Column of the atom name
+    int pos{1};                         // First of the 3 position columns
+    int ncolumns{4};                    // Columns per atom line
+
+    bool plain() const { return species == 0 && pos == 1; }
+};
+
+/**
+ * @brief Reads the Lattice="ax ay az bx by bz cx cy cz" key of an extended xyz comment line
+ *
+ * @param[in] p Start of the comment line
+ * @param[in] eol End of the comment line
+ * @param[out] matrix The box matrix with the lattice vectors as columns
+ * @return false if the line has no Lattice key
+ */
+bool parseLattice(const char* p, const char* eol, double* matrix);
+
+/**
+ * @brief Reads the Properties=name:type:count:... key of an extended xyz comment line
+ *
+ * The species and pos properties give the atom name and position columns, other
+ * real (R) and integer (I) properties are returned for storage, string (S) and
+ * logical (L) properties are skipped.
+ * @param[in] p Start of the comment line
+ * @param[in] eol End of the comment line
+ * @param[out] columns The layout of the atom lines
+ * @param[out] properties The numeric properties besides pos
+ * @return false if the line has no Properties key, columns then keep the plain layout
+ */
+bool parseProperties(const char* p, const char* eol, XYZColumns& columns, std::vector<AtomProperty>& properties);
+
+#endif // EXTXYZ_H
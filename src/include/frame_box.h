@@ -0,0 +1,34 @@
+#ifndef FRAME_BOX_H
+#define FRAME_BOX_H
+
+/**
+ * @struct FrameBox
+ * @brief Periodic box of one frame with everything the pair loops need
+ *
+ * Entries are aligned to cache lines, so threads working on different frames
+ * never share one.
+ */
+struct alignas(64) FrameBox {
+    double matrix[9];                   // Box matrix, row-major with the lattice vectors as columns
+    double inverse[9];                  // Inverse of matrix
+    double volume;                      // Determinant of matrix
+    bool orthorhombic;                  // if the off-diagonal elements vanish to rounding error
+};
+
+/**
+ * @brief Fills a box matrix from box parameters
+ *
+ * @param[in] params The lengths a, b, c and angles alpha, beta, gamma in degrees
+ * @param[out] matrix The box matrix with the lattice vectors as columns
+ */
+void boxMatrixFromParameters(const double* params, double* matrix);
+
+/**
+ * @brief Computes volume, inverse and shape of a box matrix
+ *
+ * @param[in] matrix The box matrix with the lattice vectors as columns
+ * @return The box, throws std::logic_error if the volume is not positive
+ */
+FrameBox makeFrameBox(const double* matrix);
+
+#endif // FRAME_BOX_H
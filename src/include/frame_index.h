@@ -0,0 +1,63 @@
+#ifndef FRAME_INDEX_H
+#define FRAME_INDEX_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct FrameIndex
+ * @brief Byte offset of every frame in an xyz or XTC trajectory
+ *
+ * The index is stored in a sidecar file next to the trajectory, so any frame
+ * can be reached with a single seek. The sidecar holds a small header with the
+ * size and modification time of the trajectory, then one uint64_t offset per frame.
+ */
+struct FrameIndex {
+    int natoms{0};
+    std::vector<uint64_t> offsets;
+
+    /**
+     * @brief Builds the index without decoding coordinates, XTC files are recognised by extension
+     */
+    void build(const std::string& trajectory_file_name);
+
+    /**
+     * @brief Builds the index of an xyz file by counting lines
+     */
+    void buildXYZ(const std::string& trajectory_file_name);
+
+    /**
+     * @brief Builds the index of an XTC file by hopping from frame header to frame header
+     */
+    void buildXTC(const std::string& trajectory_file_name);
+
+    /**
+     * @brief Reads the index sidecar
+     *
+     * @return false if the sidecar is missing or does not match the trajectory
+     */
+    bool read(const std::string& index_file_name, const std::string& trajectory_file_name);
+
+    /**
+     * @brief Writes the index sidecar
+     */
+    void write(const std::string& index_file_name, const std::string& trajectory_file_name) const;
+};
+
+/**
+ * @brief Default index sidecar name of a trajectory
+ */
+inline std::string indexFileName(const std::string& trajectory_file_name) {
+    return trajectory_file_name + ".mdindex";
+}
+
+/**
+ * @brief Locates the first byte of every frame in a strictly laid out xyz file
+ *
+ * Newlines are counted per chunk in parallel, then each chunk records the
+ * starts of lines whose global index is a multiple of lines_per_frame.
+ * @return Start offsets of all complete frames
+ */
+std::vector<size_t> locateXYZFrames(const char* begin, const char* end, long lines_per_frame, int threads);
+
+#endif // FRAME_INDEX_H
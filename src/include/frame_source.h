@@ -0,0 +1,250 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "extxyz.h"
+#include "compressed_file.h"
+#include "species.h"
+
+/**
+ * @struct FrameSelection
+ * @brief Frames [begin, end) of a trajectory, taking every stride-th frame
+ */
+struct FrameSelection {
+    int begin{0};
+    int end{-1};                            // -1 for all frames after begin
+    int stride{1};
+
+    bool active() const { return begin > 0 || end >= 0 || stride > 1; }
+
+    /**
+     * @brief True if trajectory frame index frame is selected
+     */
+    bool contains(int frame) const {
+        return frame >= begin && (end < 0 || frame < end) && (frame - begin) % stride == 0;
+    }
+
+    /**
+     * @brief True if no frame at or after frame is selected
+     */
+    bool finished(int frame) const { return end >= 0 && frame >= end; }
+
+    /**
+     * @brief Trajectory frame index of the i-th selected frame
+     */
+    int trajectoryFrame(int i) const { return begin + i * stride; }
+
+    /**
+     * @brief Keeps the entries of a per frame vector belonging to selected frames
+     */
+    template <typename T>
+    std::vector<T> apply(const std::vector<T>& per_frame, size_t row_size = 1) const {
+        std::vector<T> selected;
+        size_t frames = per_frame.size() / row_size;
+        for (size_t frame = begin; frame < frames && !finished(static_cast<int>(frame)); frame += stride) {
+            selected.insert(selected.end(), per_frame.begin() + frame * row_size,
+                            per_frame.begin() + (frame + 1) * row_size);
+        }
+        return selected;
+    }
+};
+
+/**
+ * @struct AtomSelection
+ * @brief Atom names kept when a trajectory is read, all atoms if empty
+ */
+struct AtomSelection {
+    std::vector<std::string> species;
+
+    bool active() const { return !species.empty(); }
+
+    /**
+     * @brief True if atoms named name are kept
+     */
+    bool keeps(const std::string& name) const;
+
+    /**
+     * @brief Maps the atoms of a trajectory to the stored atoms
+     *
+     * @param[in] names Atom names of the trajectory
+     * @param[out] indices Trajectory index of each stored atom
+     * @return Stored index of each trajectory atom, -1 if dropped
+     */
+    std::vector<int> slots(const std::vector<std::string>& names, std::vector<int>& indices) const;
+};
+
+/**
+ * @class FrameSource
+ * @brief Sequential access to the frames of a trajectory, one frame at a time
+ *
+ * A FrameSource only keeps the frame being read in memory, so trajectories of
+ * any length can be analysed with memory depending on natoms alone.
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /**
+     * @brief Number of atoms in every frame
+     */
+    virtual int natoms() const = 0;
+
+    /**
+     * @brief Atom names, in the order of the coordinates
+     */
+    virtual const std::vector<std::string>& atomNames() const = 0;
+
+    /**
+     * @brief Number of atoms in every frame of the trajectory, read or not
+     */
+    virtual int natomsTotal() const = 0;
+
+    /**
+     * @brief Index in the trajectory of each atom read
+     */
+    virtual const std::vector<int>& atomIndices() const = 0;
+
+    /**
+     * @brief Reads the next frame
+     *
+     * @param[out] coords natoms * 3 coordinates of the frame
+     * @param[out] box The boxSize() box values of the frame, or nullptr if the box is
+     *                 taken from elsewhere
+     * @return false if there are no more frames
+     */
+    virtual bool readFrame(double* coords, double* box) = 0;
+
+    /**
+     * @brief 6 if frames carry box parameters (a, b, c, A, B, C), 9 if they carry a box matrix
+     */
+    virtual int boxSize() const { return 6; }
+
+    /**
+     * @brief Seconds spent reading and parsing frames so far
+     */
+    virtual double readSeconds() const { return 0.0; }
+};
+
+/**
+ * @class PrefetchFrameSource
+ * @brief Reads frames of another FrameSource ahead of time on a background thread
+ *
+ * The producer thread fills a ring of depth frame buffers while the caller works
+ * on the previous frame, so reading overlaps with computation. The thread starts
+ * on the first readFrame, errors raised while reading are rethrown there.
+ */
+class PrefetchFrameSource : public FrameSource {
+public:
+    /**
+     * @param[in] inner The source frames are read from
+     * @param[in] depth The number of frames that can be read ahead
+     */
+    PrefetchFrameSource(std::unique_ptr<FrameSource> inner, int depth);
+    ~PrefetchFrameSource() override;
+    PrefetchFrameSource(const PrefetchFrameSource& other)              = delete;
+    PrefetchFrameSource& operator = (const PrefetchFrameSource& other) = delete;
+    PrefetchFrameSource(PrefetchFrameSource&& other)                   = delete;
+    PrefetchFrameSource& operator = (PrefetchFrameSource&& other)      = delete;
+
+    int natoms() const override { return inner_->natoms(); }
+    const std::vector<std::string>& atomNames() const override { return inner_->atomNames(); }
+    int natomsTotal() const override { return inner_->natomsTotal(); }
+    const std::vector<int>& atomIndices() const override { return inner_->atomIndices(); }
+    bool readFrame(double* coords, double* box) override;
+    int boxSize() const override { return inner_->boxSize(); }
+    double readSeconds() const override;
+
+private:
+    struct Slot {
+        std::vector<double> coords;
+        double box[9];
+    };
+
+    std::unique_ptr<FrameSource> inner_;
+    std::vector<Slot> slots_;
+    size_t head_{0};                        // Next slot handed to the caller
+    size_t filled_{0};                      // Slots read ahead and not yet handed out
+    bool read_boxes_{false};
+    bool done_{false};
+    bool stop_{false};
+    double read_seconds_{0.0};
+    std::exception_ptr error_;
+    std::thread producer_;
+    mutable std::mutex mutex_;
+    std::condition_variable slot_filled_;
+    std::condition_variable slot_freed_;
+
+    /**
+     * @brief Producer loop, reads frames until the source ends or stop_ is set
+     */
+    void produce();
+};
+
+/**
+ * @class XYZFrameSource
+ * @brief Reads xyz frames through a block buffer that only needs to hold one frame
+ *
+ * gzip and zstd trajectories are decompressed block by block as the buffer is
+ * refilled. Box parameters are read from the comment line of each frame when requested,
+ * for extended xyz files the Lattice key gives box matrices instead.
+ * Frames outside the selection are skipped by counting lines, lines of atoms
+ * outside the atom selection are skipped without being parsed.
+ */
+class XYZFrameSource : public FrameSource {
+public:
+    explicit XYZFrameSource(const std::string& filename, const FrameSelection& selection = FrameSelection(),
+                            const AtomSelection& atom_selection = AtomSelection());
+    ~XYZFrameSource() override;
+    XYZFrameSource(const XYZFrameSource& other)              = delete;
+    XYZFrameSource& operator = (const XYZFrameSource& other) = delete;
+    XYZFrameSource(XYZFrameSource&& other)                   = delete;
+    XYZFrameSource& operator = (XYZFrameSource&& other)      = delete;
+
+    int natoms() const override { return natoms_; }
+    const std::vector<std::string>& atomNames() const override { return names_; }
+    int natomsTotal() const override { return natoms_total_; }
+    const std::vector<int>& atomIndices() const override { return indices_; }
+    bool readFrame(double* coords, double* box) override;
+    int boxSize() const override { return lattice_ ? 9 : 6; }
+    double readSeconds() const override { return read_seconds_; }
+
+private:
+    DecompressingReader file_;              // Plain, gzip or zstd trajectory
+    std::vector<char> buffer_;              // Block buffer, holds at least one frame
+    size_t begin_{0};                       // First unread byte in buffer_
+    size_t end_{0};                         // End of valid bytes in buffer_
+    bool eof_{false};
+    int natoms_{0};                         // Stored atoms per frame
+    int natoms_total_{0};                   // Atom lines per frame
+    int frame_{0};                          // Index of the next frame
+    FrameSelection selection_;
+    int box_format_{-1};                    // 3 or 6 box parameters, -1 until known
+    XYZColumns columns_;                    // Layout of the atom lines
+    bool lattice_{false};                   // if comment lines carry extended xyz Lattice keys
+    double read_seconds_{0.0};
+    std::vector<std::string> names_;
+    SpeciesTable species_;                  // names_ interned, checked against every frame
+    std::vector<int> indices_;              // Trajectory index of each stored atom
+    std::vector<int> slots_;                // Stored index of each atom line, -1 if dropped
+
+    /**
+     * @brief Refills the buffer until it holds nlines complete lines after begin_
+     *
+     * @param[out] last End of the nlines-th line
+     * @return false if the file ends before nlines lines
+     */
+    bool bufferLines(long nlines, const char*& last);
+
+    /**
+     * @brief Skips blank lines before the next frame header
+     */
+    void skipBlankLines();
+};
+
+#endif // FRAME_SOURCE_H
@@ -0,0 +1,49 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a whole file
+ *
+ * The mapping is released when the MappedFile is destroyed. Files of size zero
+ * are accepted and give a null data pointer. gzip and zstd files are recognised
+ * by their magic bytes and decompressed into memory instead.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Maps filename into memory
+     *
+     * @param[in] filename The file to be mapped
+     * @param[in] sequential Hint the kernel for sequential read ahead
+     */
+    explicit MappedFile(const std::string& filename, bool sequential = true);
+    ~MappedFile();
+    MappedFile(const MappedFile& other)              = delete;
+    MappedFile& operator = (const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other)                   = delete;
+    MappedFile& operator = (MappedFile&& other)      = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+    std::vector<char> decompressed_;        // Contents of a compressed file, data_ points here
+};
+
+/**
+ * @brief Size and modification time identifying the version of a file
+ *
+ * Used to invalidate caches and indices derived from the file.
+ */
+void fileStamp(const std::string& filename, uint64_t& size, int64_t& mtime);
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,55 @@
+#ifndef NPY_H
+#define NPY_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct NpyArray
+ * @brief An array to be written in NumPy .npy format, alone or as an .npz archive entry
+ *
+ * Arrays either point to data held by the caller or own their bytes, as scalars
+ * and strings made by the factory functions do. Data is written in host byte order.
+ */
+struct NpyArray {
+    std::string name;                   // Entry name in an .npz archive, without .npy
+    std::string descr;                  // NumPy type string, such as <f8 or <U2
+    std::vector<size_t> shape;          // Empty for a 0-d array
+    const char* data{nullptr};
+    size_t nbytes{0};
+    std::vector<char> owned;            // Bytes of arrays made from a value
+
+    /**
+     * @brief A view of values with the given shape, values must outlive the array
+     */
+    static NpyArray view(const std::string& name, const std::vector<double>& values, std::vector<size_t> shape);
+
+    /**
+     * @brief A 0-d float64 array
+     */
+    static NpyArray scalar(const std::string& name, double value);
+
+    /**
+     * @brief A 0-d int64 array
+     */
+    static NpyArray scalar(const std::string& name, int64_t value);
+
+    /**
+     * @brief A 0-d unicode string array, loaded by numpy without pickle
+     */
+    static NpyArray text(const std::string& name, const std::string& value);
+};
+
+/**
+ * @brief Writes array to filename as a version 1.0 .npy file
+ */
+void writeNpy(const std::string& filename, const NpyArray& array);
+
+/**
+ * @brief Writes arrays to filename as an uncompressed .npz archive, one name.npy entry each
+ *
+ * Entries are stored without compression, the archive is limited to 4 GiB.
+ */
+void writeNpz(const std::string& filename, const std::vector<NpyArray>& arrays);
+
+#endif // NPY_H
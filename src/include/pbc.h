@@ -1,6 +1,9 @@
 #ifndef PBC_H
 #define PBC_H
-#include "settings.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "frame_box.h"
 
 /**
  * @brief Applies minimum image conversion for orthorhombic pbc box
@@ -8,9 +11,13 @@
  * @param[in,out] dx The x-distance between target atom pair
  * @param[in,out] dy The y-distance between target atom pair
  * @param[in,out] dz The z-distance between target atom pair
- * @param[in] sys System containing coordinates and box information
+ * @param[in] box The box of the frame
  */
-void pbcOrthorhombic(double& dx, double& dy, double& dz, System& sys);
+inline void pbcOrthorhombic(double& dx, double& dy, double& dz, const FrameBox& box) {
+    dx -= std::rint(dx / box.matrix[0]) * box.matrix[0];
+    dy -= std::rint(dy / box.matrix[4]) * box.matrix[4];
+    dz -= std::rint(dz / box.matrix[8]) * box.matrix[8];
+}
 
 /**
  * @brief Applies minimum image conversion for any triclinic pbc box
@@ -18,8 +25,185 @@ void pbcOrthorhombic(double& dx, double& dy, double& dz, System& sys);
  * @param[in,out] dx The x-distance between target atom pair
  * @param[in,out] dy The y-distance between target atom pair
  * @param[in,out] dz The z-distance between target atom pair
- * @param[in] sys System containing coordinates and box information
+ * @param[in] box The box of the frame
  */
-void pbcTriclinic(double& dx, double& dy, double& dz, System& sys);
+inline void pbcTriclinic(double& dx, double& dy, double& dz, const FrameBox& box) {
+    double ds[3] = {0, 0, 0};
+    for (int i = 0; i < 3; i++) {
+        ds[i] = std::rint(box.inverse[i * 3]     * dx
+                        + box.inverse[i * 3 + 1] * dy
+                        + box.inverse[i * 3 + 2] * dz);
+    }
+    dx -= box.matrix[0] * ds[0] + box.matrix[1] * ds[1] + box.matrix[2] * ds[2];
+    dy -= box.matrix[3] * ds[0] + box.matrix[4] * ds[1] + box.matrix[5] * ds[2];
+    dz -= box.matrix[6] * ds[0] + box.matrix[7] * ds[1] + box.matrix[8] * ds[2];
+}
+
+/**
+ * @brief Applies minimum image conversion to a difference of fractional coordinates
+ *
+ * The wrapped fractional difference is turned into a cartesian distance vector
+ * with the box matrix, no inverse matrix is needed.
+ * @param[in,out] dx The fractional x-difference in, the x-distance out
+ * @param[in,out] dy The fractional y-difference in, the y-distance out
+ * @param[in,out] dz The fractional z-difference in, the z-distance out
+ * @param[in] box The box of the frame
+ */
+inline void pbcFractional(double& dx, double& dy, double& dz, const FrameBox& box) {
+    double ds[3] = {dx - std::rint(dx), dy - std::rint(dy), dz - std::rint(dz)};
+    dx = box.matrix[0] * ds[0] + box.matrix[1] * ds[1] + box.matrix[2] * ds[2];
+    dy = box.matrix[3] * ds[0] + box.matrix[4] * ds[1] + box.matrix[5] * ds[2];
+    dz = box.matrix[6] * ds[0] + box.matrix[7] * ds[1] + box.matrix[8] * ds[2];
+}
+
+/**
+ * @brief Converts the cartesian coordinates of some atoms of a frame to fractional coordinates
+ *
+ * @param[in] box The box of the frame
+ * @param[in] coords Cartesian coordinates of the frame, 3 per atom
+ * @param[in] atoms The atoms to convert
+ * @param[out] fractions Fractional coordinates, 3 per atom, written for atoms only
+ */
+inline void toFractional(const FrameBox& box, const double* coords, const std::vector<int>& atoms,
+                         double* fractions) {
+    const double* inv = box.inverse;
+    for (int i : atoms) {
+        const double* r = coords + i * 3;
+        double* s = fractions + i * 3;
+        s[0] = inv[0] * r[0] + inv[1] * r[1] + inv[2] * r[2];
+        s[1] = inv[3] * r[0] + inv[4] * r[1] + inv[5] * r[2];
+        s[2] = inv[6] * r[0] + inv[7] * r[1] + inv[8] * r[2];
+    }
+}
+
+/*
+ * Box policies of the pair kernels. Each one binds a frame to its box and gives
+ * distance(a, b), the minimum image distance of two atoms, and fraction(i, s),
+ * the fractional coordinates of atom i in any image for cell searches.
+ */
+
+/**
+ * @class OrthorhombicImage
+ * @brief Cartesian frame in a rectangular box, each axis wraps on its own
+ */
+class OrthorhombicImage {
+public:
+    OrthorhombicImage(const FrameBox& box, const double* coords)
+        : coords_(coords),
+          length_{box.matrix[0], box.matrix[4], box.matrix[8]},
+          reciprocal_{1.0 / box.matrix[0], 1.0 / box.matrix[4], 1.0 / box.matrix[8]} {}
+
+    double distance(int a, int b) const {
+        double distance2 = 0;
+        for (int k = 0; k < 3; k++) {
+            double d = coords_[a * 3 + k] - coords_[b * 3 + k];
+            d -= std::rint(d * reciprocal_[k]) * length_[k];
+            distance2 += d * d;
+        }
+        return std::sqrt(distance2);
+    }
+
+    void fraction(int i, double* s) const {
+        for (int k = 0; k < 3; k++) {
+            s[k] = coords_[i * 3 + k] * reciprocal_[k];
+        }
+    }
+
+private:
+    const double* coords_;
+    double length_[3];
+    double reciprocal_[3];
+};
+
+/**
+ * @class TriclinicImage
+ * @brief Cartesian frame in any triclinic box
+ */
+class TriclinicImage {
+public:
+    TriclinicImage(const FrameBox& box, const double* coords) : box_(box), coords_(coords) {}
+
+    double distance(int a, int b) const {
+        double dx = coords_[a * 3] - coords_[b * 3];
+        double dy = coords_[a * 3 + 1] - coords_[b * 3 + 1];
+        double dz = coords_[a * 3 + 2] - coords_[b * 3 + 2];
+        pbcTriclinic(dx, dy, dz, box_);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    void fraction(int i, double* s) const {
+        const double* r = coords_ + i * 3;
+        for (int k = 0; k < 3; k++) {
+            s[k] = box_.inverse[k * 3] * r[0] + box_.inverse[k * 3 + 1] * r[1] + box_.inverse[k * 3 + 2] * r[2];
+        }
+    }
+
+private:
+    const FrameBox& box_;
+    const double* coords_;
+};
+
+/**
+ * @class FractionalImage
+ * @brief Frame of fractional coordinates in any triclinic box
+ */
+class FractionalImage {
+public:
+    FractionalImage(const FrameBox& box, const double* coords) : box_(box), coords_(coords) {}
+
+    double distance(int a, int b) const {
+        double dx = coords_[a * 3] - coords_[b * 3];
+        double dy = coords_[a * 3 + 1] - coords_[b * 3 + 1];
+        double dz = coords_[a * 3 + 2] - coords_[b * 3 + 2];
+        pbcFractional(dx, dy, dz, box_);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    void fraction(int i, double* s) const {
+        for (int k = 0; k < 3; k++) {
+            s[k] = coords_[i * 3 + k];
+        }
+    }
+
+private:
+    const FrameBox& box_;
+    const double* coords_;
+};
+
+/**
+ * @class FixedPointImage
+ * @brief Frame of fixed-point fractional coordinates, wrapped in integer arithmetic
+ */
+class FixedPointImage {
+public:
+    FixedPointImage(const FrameBox& box, const int32_t* q, int bits)
+        : box_(box), q_(q), half_(1 << (bits - 1)), mask_((1 << bits) - 1), inv_scale_(1.0 / (1 << bits)) {}
+
+    double distance(int a, int b) const {
+        const double* h = box_.matrix;
+        double ds[3];
+        for (int k = 0; k < 3; k++) {
+            int32_t dq = q_[a * 3 + k] - q_[b * 3 + k];
+            ds[k] = (((dq + half_) & mask_) - half_) * inv_scale_;
+        }
+        double dx = h[0] * ds[0] + h[1] * ds[1] + h[2] * ds[2];
+        double dy = h[3] * ds[0] + h[4] * ds[1] + h[5] * ds[2];
+        double dz = h[6] * ds[0] + h[7] * ds[1] + h[8] * ds[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    void fraction(int i, double* s) const {
+        for (int k = 0; k < 3; k++) {
+            s[k] = q_[i * 3 + k] * inv_scale_;
+        }
+    }
+
+private:
+    const FrameBox& box_;
+    const int32_t* q_;
+    int32_t half_;
+    int32_t mask_;
+    double inv_scale_;
+};
 
 #endif
@@ -4,6 +4,14 @@
 #include <utility>
 #include <string>
 #include <memory>
+#include <cstdint>
+#include "cell_list.h"
+#include "verlet_list.h"
+
+/**
+ * @brief How the atom pairs of a frame are found: all of them, or those within r_max by cell or Verlet list
+ */
+enum class PairSearch { all, cells, verlet };
 
 /**
  * @class RDFCalculator
@@ -25,6 +33,8 @@ public:
 
     /**
      * @brief Compute RDF and iRDF based on setting information
+     *
+     * Frames are pulled one at a time from the System when it is streaming.
      */
     void compute(System& sys, const Settings& settings);
 
@@ -34,10 +44,22 @@ private:
     int num_B_;                                   // Number of atoms of type B
     double factor_;                               // Normalization factor
     std::vector<std::pair<int, int>> pairs_;      // Vector of atom pairs to analyze
+    std::vector<int> atoms_A_;                    // Atoms of type A, ascending
+    std::vector<int> atoms_B_;                    // Atoms of type B, ascending
+    PairSearch search_{PairSearch::all};          // How the pairs of a frame are found
+    double r_max_{0};                             // Cutoff of the cell and Verlet lists
+    double verlet_skin_{0};                       // Extra distance kept in the Verlet list
+    CellList cell_list_;                          // Type B atoms of the current frame binned into cells
+    VerletList verlet_list_;                      // Pairs within r_max_ + verlet_skin_, reused over frames
+    bool wrap_fractional_{false};                 // if triclinic frames are converted to fractions once per frame
+    std::vector<int> atoms_AB_;                   // Atoms of type A or B, ascending, each once
     
     std::vector<double> g_;                 // RDF histogram data
     std::vector<double> incre_g_;           // Incremental RDF histogram data
     std::vector<double> minAB_;             // Array for storing minimum distances
+    std::vector<double> frame_buffer_;      // Frame converted from single precision storage
+    std::vector<int32_t> fixed_buffer_;     // Frame decoded from fixed-point storage
+    std::vector<double> fraction_buffer_;   // Fractional coordinates of atoms_AB_ in the current frame
 
     /**
      * @brief Initialize necessary vectors g_, incre_g_ and minAB_ based on settings
@@ -45,22 +67,63 @@ private:
     void initializeVectors(const Settings& settings);
 
     /**
-     * @brief Radial distribution function calculation
+     * @brief Frame calculation for one set of options, see selectFrameKernel
+     */
+    using FrameKernel = void (RDFCalculator::*)(System& sys, const Settings& settings, int frame);
+
+    /**
+     * @brief Calls visit(a, distance) for every pair of pairs_, or for the pairs near enough
      *
-     * @param[in] sys System information
-     * @param[in] settings Setting information
-     * @param[in] frame Current frame index
+     * Cell and Verlet lists are brought up to date for the frame first. They report
+     * every pair closer than r_max_ and some farther ones. Pairs come once each,
+     * grouped by A atom.
+     * @param[in] image Box policy of the frame, one of the images of pbc.h
+     */
+    template <typename Image, typename Visit>
+    void visitPairs(const FrameBox& box, const Image& image, Visit&& visit);
+
+    /**
+     * @brief Bins the pair distances of one frame into g_, and into incre_g_ if Incremental
+     *
+     * @tparam ZeroRMin if settings.r_min is 0, which drops the lower bound checks
+     * @tparam Incremental if the iRDF is computed in the same pass over the pairs
+     * @param[in] image Box policy of the frame
      */
-    void calculateRDF(System& sys, const Settings& settings, int frame);
+    template <bool ZeroRMin, bool Incremental, typename Image>
+    void histogramFrame(const FrameBox& box, const Image& image, const Settings& settings);
 
     /**
-     * @brief Incremental radial distribution function calculation
+     * @brief RDF and iRDF calculation of one frame
      *
+     * Picks the box policy for the storage of the frames and the shape of the box,
+     * orthorhombic boxes were detected when the boxes were loaded. With wrap_fractional_
+     * the atoms of a triclinic frame are converted to fractions first, so pairs only
+     * map their wrapped difference back with the box matrix.
      * @param[in] sys System information
      * @param[in] settings Setting information
      * @param[in] frame Current frame index
      */
-    void calculateIncrementalRDF(System& sys, const Settings& settings, int frame);
+    template <bool ZeroRMin, bool Incremental>
+    void calculateFrame(System& sys, const Settings& settings, int frame);
+
+    /**
+     * @brief The calculateFrame instance for r_min and increments of settings
+     */
+    static FrameKernel selectFrameKernel(const Settings& settings);
+
+    /**
+     * @brief Prints how often the Verlet list was rebuilt
+     */
+    void reportVerletBuilds(int nframes) const;
+
+    /**
+     * @brief Prints how streaming time splits into reading, waiting and compute
+     *
+     * @param[in] sys System streaming the frames
+     * @param[in] compute_seconds Time spent in the RDF and iRDF calculation
+     * @param[in] wall_seconds Time spent in the whole frame loop
+     */
+    void reportStreamTiming(const System& sys, double compute_seconds, double wall_seconds) const;
 
     /**
      * @brief Normalize RDF g_
@@ -82,26 +145,40 @@ private:
      */
     void writeIncrementalRDFOutput(const Settings& settings) const;
 
+    /**
+     * @brief Write g_, incre_g_ and the r grid as NumPy arrays with their metadata
+     *
+     * "npz" writes one archive named after rdf_output. "npy" writes the RDF and the
+     * r grid next to rdf_output, the iRDF (increments x bins) named after irdf_output,
+     * and the metadata to a json file named after rdf_output.
+     * @param[in] settings The JSON setting information
+     * @param[in] nframes The number of frames averaged
+     */
+    void writeNumpyOutput(const Settings& settings, int nframes) const;
+
     /**
      * @brief Renews minAB array for iRDF calculation
      */
     void refreshMinAB(const Settings& settings, double dAB, int& count);
 
     /**
-     * @brief Generates all index pairs for atomA and atomB from given system atom list
+     * @brief Bins the count nearest distances of one A atom into incre_g_ and resets count
+     */
+    void binMinAB(const Settings& settings, double volume, int& count);
+
+    /**
+     * @brief Sets atoms_A_, atoms_B_, atoms_AB_, num_A_ and num_B_ from the species index lists of the system
      *
      * @param[in] sys System information
      * @param[in] atomA Name of atomA
      * @param[in] atomB Name of atomB
-     * @param[in,out] num_A The number of atom A contained in system
-     * @param[in,out] num_B The number of atom B contained in system
-     */
-    std::vector<std::pair<int, int>> generatePairs(
-        const System& sys, 
-        const std::string& atomA, 
-        const std::string& atomB,
-        int& numA, 
-        int& numB);
+     */
+    void selectAtoms(const System& sys, const std::string& atomA, const std::string& atomB);
+
+    /**
+     * @brief Generates all index pairs of atoms_A_ and atoms_B_
+     */
+    std::vector<std::pair<int, int>> generatePairs() const;
 };
 
 
@@ -10,14 +10,33 @@ struct Settings {
     // files
     std::string traj_infile;
     std::string box_infile;
+    std::string topology_infile;        // atom names for dcd trajectories (xyz or pdb)
     std::string rdf_outfile;
     std::string irdf_outfile;
+    std::string output_format;          // "text", "npy" or "npz"
+    std::string neighbor_list;          // "cells" or "verlet" search pairs within r_max, "none" tests all pairs
+    double verlet_skin;                 // extra distance kept in Verlet lists
+    std::string minimum_image;          // "fractional" wraps triclinic pairs in fractional coordinates of each frame
+    std::string xyz_reader;             // "mmap" or "stream"
+    bool streaming;                     // pull frames one at a time instead of loading all
+    int prefetch_depth;                 // frames read ahead while streaming, 0 disables
+    bool trajectory_cache;              // read from / write to <trajectory>.mdcache
+    std::string cache_precision;        // "double" or "float" coordinates in the cache
+    std::string coord_precision;        // "double", "float", "fixed16" or "fixed21" coordinates held in memory
     // atoms
     std::string atomA;
     std::string atomB;
+    bool select_atoms;                  // keep only atomA and atomB atoms when reading
     // parameters for rdf and i-rdf
     double r_min, r_max;
     int bins, increments;
+    // frame selection
+    bool frame_index;                   // read / write the <trajectory>.mdindex sidecar
+    int frame_begin;                    // first frame analysed
+    int frame_end;                      // one past the last frame analysed, -1 for all
+    int frame_stride;                   // analyse every frame_stride-th frame
+    // parallelism
+    int threads;                        // 0 uses all hardware threads
 
     /**
      * @brief Reads setting information from JSON file
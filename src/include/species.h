@@ -0,0 +1,59 @@
+#ifndef SPECIES_H
+#define SPECIES_H
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * @struct SpeciesTable
+ * @brief Atom names interned into species IDs
+ *
+ * Every distinct atom name is stored once, each atom keeps the 16-bit ID of its
+ * species. The atoms of every species are listed in ascending order, so analyses
+ * select atoms by species without comparing strings.
+ */
+struct SpeciesTable {
+    std::vector<std::string> names;         // Name of each species, in order of first appearance
+    std::vector<uint16_t> types;            // Species of each atom
+    std::vector<std::vector<int>> atoms;    // Atoms of each species, ascending
+
+    /**
+     * @brief Interns the name of every atom
+     *
+     * @param[in] atom_names One name per atom
+     */
+    void assign(const std::vector<std::string>& atom_names);
+
+    /**
+     * @brief Takes a species table and the species of every atom, as stored in a trajectory cache
+     *
+     * @param[in] species_names The name of each species
+     * @param[in] atom_types The species of each atom
+     * @param[in] count The number of atoms
+     */
+    void assign(const std::vector<std::string>& species_names, const uint16_t* atom_types, int count);
+
+    /**
+     * @brief The species ID of name, -1 if no atom has that name
+     */
+    int find(const std::string& name) const;
+
+    /**
+     * @brief The name of atom
+     */
+    const std::string& name(int atom) const { return names[types[atom]]; }
+
+    /**
+     * @brief True if atom is named by the length characters at name
+     */
+    bool matches(int atom, const char* name, size_t length) const {
+        const std::string& species = names[types[atom]];
+        return species.size() == length && memcmp(species.data(), name, length) == 0;
+    }
+
+    bool empty() const { return types.empty(); }
+    void clear();
+};
+
+#endif // SPECIES_H
@@ -1,7 +1,15 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 #include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
 #include "settings.h"
+#include "frame_source.h"
+#include "mapped_file.h"
+#include "frame_index.h"
+#include "species.h"
+#include "frame_box.h"
 
 /**
  * @struct System
@@ -10,21 +18,51 @@
  * The System struct stores atomic and periodic boundary condition info from trajectory
  * and box input files stored in JSON Setting. 
  *
- * @note Currently only handles xyz input. Can read box information from xyz or separate file.
+ * In streaming mode coords holds only the current frame, which is refreshed by nextFrame.
+ * With single precision storage frames are kept in coords_single instead, readers fill
+ * frames through frameBuffer and storeFrame and consumers read them with frameCoords.
+ * Once the boxes are known, frames can be encoded as fixed-point fractional coordinates,
+ * which are read with fixedFrame.
+ *
+ * @note Handles xyz, DCD, XTC and LAMMPS dump input. Can read box information from the trajectory or a separate file.
  */
 struct System {
     bool traj_allocated = false;
     bool box_allocated = false;
     bool fixed_volume;                  // if pbc is fixed
+    bool streaming = false;             // if frames are pulled one at a time from source
 
     int nframes{0};
     int natoms{0};
-    double box_volume{0};               // Volume of box at requested frame
-    std::string* atoms{nullptr};
+    int frame_capacity{0};              // Frames that fit in coords before regrowing
+    SpeciesTable species;               // Species ID of each stored atom and the atoms of each species
     double* coords{nullptr};
+    float* coords_single{nullptr};      // Coordinates in single precision storage, used instead of coords
+    bool single_precision = false;      // if frames are stored in coords_single
+    int fixed_bits{0};                  // 16 or 21 if frames are stored as fixed-point fractional coordinates
+    std::vector<uint16_t> coords_fixed16;   // 3 fractions of 16 bits per atom
+    std::vector<uint64_t> coords_fixed21;   // 3 fractions of 21 bits packed per atom
     double* boxes{nullptr};
-    double* box_matrix{nullptr};        // Matrix of box at requested frame
-    double* box_inverse{nullptr};       // Inverse matrix of box at requested frame
+    std::vector<FrameBox> frame_boxes;  // Box of every frame, a single entry for a fixed or streamed box
+
+    std::vector<double> xyz_boxes;      // Box parameters from xyz comment lines or binary trajectories
+    std::string xyz_box_error;          // Why comment lines could not be read as boxes
+    std::vector<double> box_matrices;   // Box matrices read from the trajectory, 9 per frame, used instead of boxes
+    bool fractional = false;            // if coords hold fractional coordinates, r = matrix * s
+    std::vector<AtomProperty> atom_properties; // Extra per-atom columns of extended xyz, not cached
+
+    std::unique_ptr<MappedFile> coords_map; // Trajectory cache mapping when coords point into it
+    std::vector<size_t> frame_offsets;      // Byte offset of each frame read by the mmap readers
+    FrameSelection selection;               // Frames of the trajectory kept in System
+    AtomSelection atom_selection;           // Atom names of the trajectory kept in System
+    int natoms_total{0};                    // Atoms per frame in the trajectory file
+    std::vector<int> atom_indices;          // Trajectory index of each stored atom
+    std::vector<int> atom_slots;            // Stored index of each trajectory atom, -1 if dropped
+
+    std::unique_ptr<FrameSource> source;    // Frame source in streaming mode
+    std::vector<double> stream_boxes;       // Box file parameters used in streaming mode
+    std::vector<double> stream_box_built;   // Box parameters or matrix frame_boxes was last built from while streaming
+    double stream_wait_seconds{0};          // Time nextFrame waited for frames
     
     System() = default;
     ~System();
@@ -38,6 +76,63 @@ struct System {
      */
     void allocateTrajectoryMemory();
 
+    /**
+     * @brief Grows coordinate memory so that at least min_frames frames fit
+     *
+     * Capacity is doubled on growth, frames already read are preserved.
+     * @param[in] min_frames The number of frames that must fit in coords
+     */
+    void growTrajectoryMemory(int min_frames);
+
+    /**
+     * @brief Frees the coordinate storage, mapped or allocated
+     */
+    void releaseCoordinates();
+
+    /**
+     * @brief Where a reader writes the double precision coordinates of frame
+     *
+     * Points into coords, or with single precision storage to a scratch frame of
+     * the calling thread that storeFrame converts. Frame memory must be allocated.
+     * @param[in] frame The stored frame index
+     */
+    double* frameBuffer(int frame);
+
+    /**
+     * @brief Stores a frame written to frameBuffer(frame)
+     *
+     * @param[in] frame The stored frame index
+     * @param[in] frame_coords The pointer returned by frameBuffer
+     */
+    void storeFrame(int frame, const double* frame_coords);
+
+    /**
+     * @brief Double precision coordinates of frame
+     *
+     * @param[in] frame The stored frame index
+     * @param[in,out] buffer Receives the converted frame with single precision storage
+     * @return Pointer to natoms * 3 coordinates, into coords or buffer
+     */
+    const double* frameCoords(int frame, std::vector<double>& buffer) const;
+
+    /**
+     * @brief Encodes all frames as fixed-point fractional coordinates of their boxes
+     *
+     * Fractions are wrapped into [0, 1) and rounded to multiples of 2^-bits, the
+     * coordinate storage is released afterwards. Needs the boxes of all frames.
+     * @param[in] bits 16 or 21 bits per fractional coordinate
+     */
+    void encodeFixedPoint(int bits);
+
+    /**
+     * @brief Fixed-point fractional coordinates of frame, 3 integers in [0, 2^fixed_bits) per atom
+     *
+     * @param[in] frame The stored frame index
+     * @param[in,out] buffer Receives the decoded frame
+     * @return Pointer to natoms * 3 integers in buffer
+     */
+    const int32_t* fixedFrame(int frame, std::vector<int32_t>& buffer) const;
+
     /**
      * @brief Allocates memory for box information
      */
@@ -46,10 +141,168 @@ struct System {
     /**
      * @brief Reads atoms and coordinate information from filename
      *
+     * The file is read in a single pass. Box parameters found in the comment
+     * lines are kept in xyz_boxes for readBoxFromXYZ. Frames outside selection
+     * are skipped without parsing.
      * @param[in] filename The xyz trajectory file name. 
      */
     void readXYZ(const std::string &filename);
 
+    /**
+     * @brief Reads the trajectory named in settings with the requested reader
+     *
+     * @param[in] settings The JSON setting information.
+     */
+    void readTrajectory(const Settings& settings);
+
+    /**
+     * @brief Opens the trajectory for streaming instead of reading all frames
+     *
+     * Atom names are read from the first frame and coords holds a single frame.
+     * @param[in] settings The JSON setting information.
+     */
+    void openTrajectory(const Settings& settings);
+
+    /**
+     * @brief Reads the next streamed frame into coords and boxes
+     *
+     * The frame is stored at frame index 0, nframes counts the frames read so far.
+     * @return false if the trajectory has no more frames
+     */
+    bool nextFrame();
+
+    /**
+     * @brief Reads atoms, coordinates and comment line boxes from a binary trajectory cache
+     *
+     * Double precision caches are used in place from the mapping.
+     * @param[in] cache_file_name The cache file
+     * @param[in] source_file_name The trajectory the cache was made from
+     * @param[in] topology_file_name The file naming the atoms, empty if the trajectory names them
+     * @param[in] precision Bytes per stored coordinate the cache must have, 4 or 8
+     * @return false if the cache is missing or stale
+     */
+    bool readCache(const std::string& cache_file_name, const std::string& source_file_name,
+                   const std::string& topology_file_name, int precision);
+
+    /**
+     * @brief Writes atoms, coordinates and comment line boxes to a binary trajectory cache
+     *
+     * Nothing is written for trajectories with extended xyz columns, the cache does not hold them.
+     * @param[in] cache_file_name The cache file
+     * @param[in] source_file_name The trajectory the System was read from
+     * @param[in] topology_file_name The file naming the atoms, empty if the trajectory names them
+     * @param[in] precision Bytes per stored coordinate, 4 or 8
+     */
+    void writeCache(const std::string& cache_file_name, const std::string& source_file_name,
+                    const std::string& topology_file_name, int precision) const;
+
+    /**
+     * @brief Reads atoms and coordinate information from a memory mapped xyz file
+     *
+     * Same result as readXYZ, but scans the mapped bytes directly and parses numbers
+     * without allocating per line. Extended xyz files are recognised by their first
+     * comment line: Lattice keys fill box_matrices, Properties give the column layout
+     * and extra numeric columns such as forces are kept in atom_properties.
+     * @param[in] filename The xyz trajectory file name.
+     */
+    void readXYZMapped(const std::string &filename);
+
+    /**
+     * @brief Reads the selected frames of a DCD trajectory
+     *
+     * Frames are located by offset and decoded with threads threads. Unit cell
+     * records are kept in xyz_boxes for readBoxFromXYZ.
+     * @param[in] filename The DCD trajectory file name.
+     * @param[in] topology_file_name The xyz or pdb file naming the atoms
+     * @param[in] threads The number of decoding threads
+     */
+    void readDCD(const std::string &filename, const std::string &topology_file_name, int threads);
+
+    /**
+     * @brief Reads the selected frames of an XTC trajectory
+     *
+     * Frames are reached through the offsets of index and decoded with threads
+     * threads. The stored box vectors become the columns of box_matrices.
+     * @param[in] filename The XTC trajectory file name.
+     * @param[in] topology_file_name The xyz or pdb file naming the atoms
+     * @param[in] index The frame index of the trajectory
+     * @param[in] threads The number of decoding threads
+     */
+    void readXTC(const std::string &filename, const std::string &topology_file_name,
+                 const FrameIndex& index, int threads);
+
+    /**
+     * @brief Reads a LAMMPS dump file (dump atom / custom)
+     *
+     * Box bounds and xy xz yz tilt factors are turned into box_matrices directly.
+     * Scaled xs ys zs (or xsu ysu zsu) columns are kept as fractional coordinates,
+     * otherwise x y z (or xu yu zu) are read. Atoms are ordered by id, named by the
+     * element column if present, else by type. Frames outside selection are skipped.
+     * @param[in] filename The LAMMPS dump file name.
+     */
+    void readLAMMPS(const std::string &filename);
+
+    /**
+     * @brief Reads a memory mapped xyz file with several threads
+     *
+     * Frame starts are located by counting natoms + 2 lines per frame, then frames
+     * are parsed concurrently into coords. Requires every frame to span exactly
+     * natoms + 2 lines, without blank lines in between.
+     * @param[in] filename The xyz trajectory file name.
+     * @param[in] threads The number of parsing threads
+     */
+    void readXYZParallel(const std::string &filename, int threads);
+
+    /**
+     * @brief Reads the selected frames of a memory mapped xyz file located by a frame index
+     *
+     * Frames outside the selection are never touched.
+     * @param[in] filename The xyz trajectory file name.
+     * @param[in] index The frame index of the trajectory
+     * @param[in] threads The number of parsing threads
+     */
+    void readXYZIndexed(const std::string &filename, const FrameIndex& index, int threads);
+
+    /**
+     * @brief Parses the xyz frames starting at the given offsets of a mapped file
+     *
+     * The atoms stored are set up from the first frame. Frames are parsed concurrently
+     * with threads threads.
+     * @param[in] file The mapped trajectory
+     * @param[in] starts Byte offset of each selected frame
+     * @param[in] threads The number of parsing threads
+     */
+    void parseXYZFrames(const MappedFile& file, const std::vector<size_t>& starts, int threads);
+
+    /**
+     * @brief Drops the frames outside selection from a fully read trajectory
+     */
+    void applyFrameSelection();
+
+    /**
+     * @brief Sets up the stored atoms from the atom names of the first frame
+     *
+     * Sets natoms_total, atom_indices and atom_slots from atom_selection, natoms to
+     * the number of stored atoms, then allocates trajectory memory for nframes frames.
+     * @param[in] trajectory_atoms The atom names of the trajectory
+     */
+    void setupAtoms(const std::vector<std::string>& trajectory_atoms);
+
+    /**
+     * @brief Drops the atoms outside atom_selection from a trajectory read with all atoms
+     */
+    void applyAtomSelection();
+
+    /**
+     * @brief Prints how many atoms per frame are kept by the atom selection
+     */
+    void reportAtomSelection() const;
+
+    /**
+     * @brief Prints the extra per-atom columns read from an extended xyz trajectory
+     */
+    void reportAtomProperties() const;
+
     /**
      * @brief Reads box information from Settings parameter
      *
@@ -58,9 +311,11 @@ struct System {
     void readBox(const Settings& settings);
 
     /**
-     * @brief Reads box information from comment lines in xyz trajectory file
+     * @brief Reads box information collected from the trajectory
+     *
+     * Box matrices are used as they are, box parameters go through storeBoxData.
      */
-    void readBoxFromXYZ(const std::string &trajectory_file_name);
+    void readBoxFromXYZ();
 
     /**
      * @brief Reads box information from a separate box file
@@ -68,17 +323,58 @@ struct System {
     void readBoxFromFile(const std::string &box_file_name);
 
     /**
-     * @brief Calculates inverse matrix of the periodic boundary box
+     * @brief Reads all box parameter lines of a box file, 6 values per line
+     */
+    static std::vector<double> readBoxLines(const std::string &box_file_name);
+
+    /**
+     * @brief Parses one line of 3 (a, b, c) or 6 (a, b, c, A, B, C) box parameters
+     *
+     * @param[in] line The line containing box parameters
+     * @param[in,out] box_format -1 if unknown, set to 3 or 6 by the first parsed line
+     * @return The 6 box parameters, angles default to 90 for 3 parameter lines
+     */
+    static std::vector<double> parseBoxLine(const std::string& line, int& box_format);
+
+    /**
+     * @brief Validates count box values against box_format and expands them to 6 parameters
+     *
+     * @param[in] values The box values read from a line
+     * @param[in] count The number of values, 3 or 6
+     * @param[in,out] box_format -1 if unknown, set to 3 or 6 by the first call
+     * @param[out] box_params The 6 box parameters
+     */
+    static void expandBoxParams(const double* values, int count, int& box_format, double* box_params);
+
+    /**
+     * @brief Prints parse throughput in MB/s
+     */
+    static void reportThroughput(size_t bytes, double seconds);
+
+    /**
+     * @brief Copies box parameters (6 per frame) into boxes
+     *
+     * A single box is treated as fixed volume, otherwise one box per frame is required.
+     */
+    void storeBoxData(const std::vector<double>& box_data);
+
+    /**
+     * @brief Computes frame_boxes from boxes or box_matrices
+     *
+     * Matrices, volumes and inverses of all frames are computed once, in parallel.
+     * Streamed frames refresh the single entry when they are read.
+     * @param[in] threads The number of threads
      */
-    void updateBoxInverse();
+    void buildBoxTable(int threads);
 
     /**
-     * @brief Updates box information in current frame.
+     * @brief The box of frame, readable from any thread
      *
-     * Updates the box matrix, box volume and box inverse matrix for current frame
-     * @param[in] frame Current frame index for box information update
+     * @param[in] frame The stored frame index
      */
-    void updateBoxInformation(int frame);
+    const FrameBox& frameBox(int frame) const {
+        return frame_boxes[frame_boxes.size() == 1 ? 0 : frame];
+    }
 };
 
 #endif
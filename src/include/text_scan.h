@@ -0,0 +1,105 @@
+#ifndef TEXT_SCAN_H
+#define TEXT_SCAN_H
+#include <charconv>
+#include <cstring>
+
+/**
+ * @brief Allocation free scanning helpers for text trajectories in memory
+ *
+ * All functions work on a [p, end) byte range and return the position after
+ * what they consumed. Numbers are parsed with std::from_chars, which is
+ * locale independent and rounds the same way as the stream extractors.
+ */
+namespace textscan {
+
+/**
+ * @brief Skips spaces, tabs and carriage returns, stops at newline
+ */
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Returns the position of the next newline, or end
+ */
+inline const char* lineEnd(const char* p, const char* end) {
+    const void* nl = memchr(p, '\n', end - p);
+    return nl ? static_cast<const char*>(nl) : end;
+}
+
+/**
+ * @brief Returns the position just after the next newline, or end
+ */
+inline const char* nextLine(const char* p, const char* end) {
+    const char* nl = lineEnd(p, end);
+    return nl < end ? nl + 1 : end;
+}
+
+/**
+ * @brief Skips n lines, without looking at their content
+ */
+inline const char* skipLines(const char* p, const char* end, long n) {
+    for (long i = 0; i < n && p < end; i++) {
+        p = nextLine(p, end);
+    }
+    return p;
+}
+
+/**
+ * @brief Returns true if [p, line_end) only contains blanks
+ */
+inline bool blankLine(const char* p, const char* line_end) {
+    return skipBlanks(p, line_end) == line_end;
+}
+
+/**
+ * @brief Reads a whitespace delimited token
+ *
+ * @param[out] token Start of the token, length is returned in length
+ * @return Position after the token, p if no token before the end of line
+ */
+inline const char* parseToken(const char* p, const char* end, const char*& token, size_t& length) {
+    p = skipBlanks(p, end);
+    token = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+        p++;
+    }
+    length = static_cast<size_t>(p - token);
+    return p;
+}
+
+/**
+ * @brief Parses a floating point number after optional blanks
+ *
+ * @return Position after the number, nullptr if no number could be read
+ */
+inline const char* parseDouble(const char* p, const char* end, double& value) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') {
+        p++;
+    }
+    std::from_chars_result result = std::from_chars(p, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+/**
+ * @brief Parses an integer after optional blanks
+ *
+ * @return Position after the number, nullptr if no number could be read
+ */
+template <typename Int>
+inline const char* parseInteger(const char* p, const char* end, Int& value) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') {
+        p++;
+    }
+    std::from_chars_result result = std::from_chars(p, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+} // namespace textscan
+
+#endif // TEXT_SCAN_H
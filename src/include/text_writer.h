@@ -0,0 +1,95 @@
+#ifndef TEXT_WRITER_H
+#define TEXT_WRITER_H
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @class TextWriter
+ * @brief Block buffered text output formatted with std::to_chars
+ *
+ * fixed(value, precision) writes the same characters as
+ * stream << std::fixed << std::setprecision(precision) << value, without the
+ * locale and stream state work of iostream formatting. The buffer is written
+ * to the file whenever it fills up, and by close.
+ */
+class TextWriter {
+public:
+    /**
+     * @brief Opens filename for writing, is_open() tells if that succeeded
+     */
+    explicit TextWriter(const std::string& filename);
+
+    bool is_open() const { return file_.is_open(); }
+
+    TextWriter& text(const std::string& value) {
+        reserve(value.size());
+        buffer_.append(value);
+        return *this;
+    }
+
+    TextWriter& text(const char* value) {
+        size_t length = strlen(value);
+        reserve(length);
+        buffer_.append(value, length);
+        return *this;
+    }
+
+    TextWriter& character(char value) {
+        reserve(1);
+        buffer_ += value;
+        return *this;
+    }
+
+    TextWriter& integer(long value) {
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        reserve(result.ptr - digits);
+        buffer_.append(digits, result.ptr);
+        return *this;
+    }
+
+    /**
+     * @brief Writes value in fixed notation with precision decimals
+     */
+    TextWriter& fixed(double value, int precision) {
+        char digits[FIXED_DIGITS];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value,
+                                                    std::chars_format::fixed, precision);
+        if (result.ec != std::errc()) {
+            return text(longFixed(value, precision));
+        }
+        reserve(result.ptr - digits);
+        buffer_.append(digits, result.ptr);
+        return *this;
+    }
+
+    /**
+     * @brief Writes the buffered text and closes the file
+     */
+    void close();
+
+private:
+    static const size_t BLOCK_SIZE = 1 << 20;   // Bytes buffered before writing to the file
+    static const int FIXED_DIGITS = 64;         // Enough for values below 1e40 in fixed notation
+
+    std::ofstream file_;
+    std::string buffer_;
+
+    void reserve(size_t bytes) {
+        if (buffer_.size() + bytes > BLOCK_SIZE) {
+            flush();
+        }
+    }
+
+    void flush();
+
+    /**
+     * @brief Fixed notation of values too large for the digit buffer
+     */
+    static std::string longFixed(double value, int precision);
+};
+
+#endif // TEXT_WRITER_H
@@ -0,0 +1,32 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+#include <string>
+#include <vector>
+
+/**
+ * @brief Reads the atom names of a topology for binary trajectories without names
+ *
+ * Accepted are xyz files, whose first frame gives the names, and pdb files, whose
+ * ATOM and HETATM records give the element symbol or, without one, the atom name.
+ * @param[in] filename The topology file
+ * @return One name per atom, in trajectory order
+ */
+std::vector<std::string> readAtomNames(const std::string& filename);
+
+/**
+ * @brief True if filename ends in extension, compared case insensitively
+ *
+ * A trailing .gz or .zst is skipped, since compressed inputs are read transparently.
+ * @param[in] filename The file name
+ * @param[in] extension The extension including the dot, in lower case
+ */
+bool hasExtension(const std::string& filename, const std::string& extension);
+
+/**
+ * @brief True if filename is a LAMMPS dump, ending in .lammpstrj or .dump
+ */
+inline bool isLAMMPSDump(const std::string& filename) {
+    return hasExtension(filename, ".lammpstrj") || hasExtension(filename, ".dump");
+}
+
+#endif // TOPOLOGY_H
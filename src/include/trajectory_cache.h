@@ -0,0 +1,52 @@
+#ifndef TRAJECTORY_CACHE_H
+#define TRAJECTORY_CACHE_H
+#include <cstdint>
+#include <string>
+
+/**
+ * @struct CacheHeader
+ * @brief Header of the binary trajectory cache written next to a parsed trajectory
+ *
+ * The cache holds, in this order and at the given offsets:
+ * - the atom type table: ntypes null terminated names
+ * - one uint16_t type index per atom
+ * - nframes * natoms * 3 coordinates in float or double precision
+ * - nbox_rows * 6 box parameters in the System::boxes layout, or nbox_rows * 9
+ *   box matrix entries if flags has CACHE_BOX_MATRICES
+ *
+ * Coordinates start on a 64 byte boundary so they can be used straight from the mapping.
+ * The cache is stale once size or modification time of the source file or of the
+ * topology file naming its atoms change, or once another precision is requested.
+ */
+struct CacheHeader {
+    char magic[8];                      // "MDTCACHE"
+    uint32_t version;
+    uint32_t byte_order;                // 0x01020304 as written by the producing machine
+    uint32_t precision;                 // Bytes per coordinate, 4 or 8
+    int32_t natoms;
+    int32_t nframes;
+    int32_t ntypes;
+    int32_t nbox_rows;                  // 0 if the comment lines hold no boxes
+    int32_t flags;                      // CACHE_BOX_MATRICES, CACHE_FRACTIONAL
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t topology_size;             // 0 if the atom names come from the trajectory
+    int64_t topology_mtime;
+    uint64_t types_offset;
+    uint64_t coords_offset;
+    uint64_t boxes_offset;
+};
+
+constexpr uint32_t CACHE_VERSION = 3;
+constexpr int32_t CACHE_BOX_MATRICES = 1;   // Boxes are System::box_matrices rows
+constexpr int32_t CACHE_FRACTIONAL = 2;     // Coordinates are fractional
+constexpr uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+/**
+ * @brief Default cache file name of a trajectory
+ */
+inline std::string cacheFileName(const std::string& trajectory_file_name) {
+    return trajectory_file_name + ".mdcache";
+}
+
+#endif // TRAJECTORY_CACHE_H
@@ -0,0 +1,145 @@
+#ifndef VERLET_LIST_H
+#define VERLET_LIST_H
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "cell_list.h"
+#include "frame_box.h"
+
+/**
+ * @class VerletList
+ * @brief A-B candidate pairs within cutoff + skin, kept over frames until atoms move too far
+ *
+ * The list is rebuilt with a cell list once the skin no longer covers what changed
+ * since the last build. Displacements d are measured in the box of the last build H0,
+ * from the wrapped change of fractional coordinates. A box H deformed since then
+ * stretches pair distances by at most lambda = 1 + ||H0 H^-1 - I||_F, so a pair closer
+ * than cutoff now was closer than lambda * cutoff + 2 * max d at the last build, and
+ * the list holds it while (lambda - 1) * cutoff + 2 * max d <= skin. In a fixed box
+ * that is the usual test of skin / 2. Distances are minimum image distances over all
+ * periodic images.
+ */
+class VerletList {
+public:
+    /**
+     * @brief Rebuilds the list if the atoms moved or the box deformed too far since the last build
+     *
+     * @param[in] box The box of the frame
+     * @param[in] cutoff The largest pair distance searched
+     * @param[in] skin The extra distance kept in the list
+     * @param[in] atoms_A The first atom of every pair
+     * @param[in] atoms_B The second atom of every pair
+     * @param[in] fraction fraction(atom, s) writes the 3 fractional coordinates of atom to s, in any image
+     * @return true if the list was rebuilt
+     */
+    template <typename Fraction>
+    bool update(const FrameBox& box, double cutoff, double skin, const std::vector<int>& atoms_A,
+                const std::vector<int>& atoms_B, Fraction&& fraction) {
+        if (built_ && strain(box) * cutoff + 2 * maxDisplacement(fraction) <= skin) {
+            return false;
+        }
+        build(box, cutoff + skin, atoms_A, atoms_B, fraction);
+        return true;
+    }
+
+    /**
+     * @brief The candidate pairs, grouped by A atom in the order of atoms_A
+     */
+    const std::vector<std::pair<int, int>>& pairs() const { return pairs_; }
+
+    /**
+     * @brief Number of builds so far
+     */
+    int builds() const { return builds_; }
+
+private:
+    CellList cells_;
+    std::vector<std::pair<int, int>> pairs_;
+    std::vector<int> tracked_;              // Atoms of A and B whose displacement is checked
+    std::vector<double> reference_;         // Fractional coordinates of tracked_ at the last build
+    FrameBox reference_box_{};              // Box at the last build
+    bool built_{false};
+    int builds_{0};
+
+    /**
+     * @brief Bound on the relative stretch of distances from the box of the last build to box
+     *
+     * @return ||H0 H^-1 - I||_F, 0 for an unchanged box
+     */
+    double strain(const FrameBox& box) const;
+
+    /**
+     * @brief Images to search along each lattice vector for pairs closer than cutoff
+     */
+    static void imageRange(const FrameBox& box, double cutoff, int* range);
+
+    /**
+     * @brief Minimum image distance of a fractional difference over the images within range
+     */
+    static double imageDistance(const FrameBox& box, const double* ds, const int* range);
+
+    /**
+     * @brief Largest displacement of a tracked atom since the last build, in the box of that build
+     */
+    template <typename Fraction>
+    double maxDisplacement(Fraction&& fraction) const {
+        int nearest[3] = {0, 0, 0};
+        double max_displacement = 0;
+        for (size_t i = 0; i < tracked_.size(); i++) {
+            double s[3];
+            fraction(tracked_[i], s);
+            double ds[3];
+            for (int k = 0; k < 3; k++) {
+                ds[k] = s[k] - reference_[i * 3 + k];
+                ds[k] -= std::rint(ds[k]);
+            }
+            max_displacement = std::max(max_displacement, imageDistance(reference_box_, ds, nearest));
+        }
+        return max_displacement;
+    }
+
+    template <typename Fraction>
+    void build(const FrameBox& box, double cutoff, const std::vector<int>& atoms_A,
+               const std::vector<int>& atoms_B, Fraction&& fraction) {
+        if (!built_) {
+            trackAtoms(atoms_A, atoms_B);
+        }
+        reference_.resize(tracked_.size() * 3);
+        for (size_t i = 0; i < tracked_.size(); i++) {
+            fraction(tracked_[i], &reference_[i * 3]);
+        }
+        reference_box_ = box;
+
+        // slightly longer cutoff, so rounding of fractions cannot drop a pair
+        int range[3];
+        imageRange(box, cutoff, range);
+        double limit = cutoff * (1 + 1e-9);
+        cells_.build(box, cutoff, atoms_B, fraction);
+        pairs_.clear();
+        for (int a : atoms_A) {
+            double sa[3];
+            fraction(a, sa);
+            cells_.forEachNeighbor(sa, [&](int b) {
+                double sb[3], ds[3];
+                fraction(b, sb);
+                for (int k = 0; k < 3; k++) {
+                    ds[k] = sa[k] - sb[k];
+                    ds[k] -= std::rint(ds[k]);
+                }
+                if (imageDistance(box, ds, range) < limit) {
+                    pairs_.push_back(std::make_pair(a, b));
+                }
+            });
+        }
+        built_ = true;
+        builds_++;
+    }
+
+    /**
+     * @brief Sets tracked_ to the atoms of A and B, each once
+     */
+    void trackAtoms(const std::vector<int>& atoms_A, const std::vector<int>& atoms_B);
+};
+
+#endif // VERLET_LIST_H
@@ -0,0 +1,84 @@
+#ifndef XTC_H
+#define XTC_H
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "frame_source.h"
+
+/**
+ * @class XTCFile
+ * @brief Decoding of GROMACS XTC frames straight from the mapped file
+ *
+ * Frames are stored in XDR (big endian) with coordinates compressed by the
+ * xdr3dfcoor scheme: integers at the file precision, packed in mixed radix
+ * with runs of small differences between neighbouring atoms. Frames have
+ * different sizes, so frames are located by hopping from header to header
+ * once, after which every frame can be decoded independently and concurrently.
+ * Coordinates and boxes stay in nm, as stored.
+ */
+class XTCFile {
+public:
+    /**
+     * @param[in] filename The XTC trajectory
+     * @param[in] sequential Hint the kernel for sequential read ahead
+     */
+    explicit XTCFile(const std::string& filename, bool sequential = true);
+
+    int natoms() const { return natoms_; }
+    size_t size() const { return map_.size(); }
+
+    /**
+     * @brief Offset one past the frame starting at offset, 0 if the frame is truncated
+     */
+    size_t frameEnd(size_t offset) const;
+
+    /**
+     * @brief Decodes the frame at offset and keeps the coordinates of some atoms
+     *
+     * @param[in] offset Byte offset of the frame
+     * @param[in] indices The trajectory index of each atom read
+     * @param[out] coords indices.size() * 3 coordinates
+     * @param[out] box The 9 values of the box matrix, lattice vectors as columns, or nullptr
+     * @return false if the frame has no box (all box vectors zero)
+     */
+    bool readFrame(size_t offset, const std::vector<int>& indices, double* coords, double* box) const;
+
+private:
+    MappedFile map_;
+    int natoms_{0};
+};
+
+/**
+ * @class XTCFrameSource
+ * @brief Streams the selected frames of an XTC trajectory, hopping over unselected frames
+ */
+class XTCFrameSource : public FrameSource {
+public:
+    /**
+     * @param[in] filename The XTC trajectory
+     * @param[in] names Atom names of the trajectory, from a topology
+     * @param[in] selection Frames read
+     * @param[in] atom_selection Atoms read
+     */
+    XTCFrameSource(const std::string& filename, const std::vector<std::string>& names,
+                   const FrameSelection& selection, const AtomSelection& atom_selection);
+
+    int natoms() const override { return static_cast<int>(indices_.size()); }
+    int natomsTotal() const override { return file_.natoms(); }
+    const std::vector<std::string>& atomNames() const override { return names_; }
+    const std::vector<int>& atomIndices() const override { return indices_; }
+    bool readFrame(double* coords, double* box) override;
+    int boxSize() const override { return 9; }
+    double readSeconds() const override { return read_seconds_; }
+
+private:
+    XTCFile file_;
+    FrameSelection selection_;
+    std::vector<std::string> names_;
+    std::vector<int> indices_;
+    size_t offset_{0};                      // Offset of the next frame
+    int frame_{0};                          // Index of the next frame
+    double read_seconds_{0.0};
+};
+
+#endif // XTC_H
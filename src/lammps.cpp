@@ -0,0 +1,313 @@
+/**
+ * @file lammps.cpp
+ * @brief Memory mapped LAMMPS dump parsing
+ *
+ * Reads the text dumps of the LAMMPS dump atom and dump custom styles. The box
+ * matrix of each frame is built from the box bounds and the xy xz yz tilt factors
+ * as LAMMPS defines them, a = (lx, 0, 0), b = (xy, ly, 0), c = (xz, yz, lz), so no
+ * angles are involved. Scaled coordinates are kept as fractional coordinates.
+ */
+
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "mapped_file.h"
+#include "text_scan.h"
+#include "system.h"
+
+namespace {
+
+/**
+ * @struct DumpColumns
+ * @brief Columns of the ITEM: ATOMS section used by the reader, -1 if absent
+ */
+struct DumpColumns {
+    int id{-1};
+    int name{-1};                           // element column, type column if there is none
+    int coord[3]{-1, -1, -1};
+    bool scaled{false};
+    int used{0};                            // Columns up to the last one used
+};
+
+bool startsWith(const char* p, const char* eol, const char* prefix) {
+    size_t length = strlen(prefix);
+    return static_cast<size_t>(eol - p) >= length && memcmp(p, prefix, length) == 0;
+}
+
+/**
+ * @brief Finds the columns of the ITEM: ATOMS header, p pointing after "ITEM: ATOMS"
+ */
+DumpColumns parseAtomsHeader(const char* p, const char* eol) {
+    std::vector<std::string> names;
+    const char* token;
+    size_t length;
+    while ((p = textscan::parseToken(p, eol, token, length)), length > 0) {
+        names.emplace_back(token, length);
+    }
+
+    auto column = [&names](const char* name) {
+        auto found = std::find(names.begin(), names.end(), name);
+        return found == names.end() ? -1 : static_cast<int>(found - names.begin());
+    };
+
+    DumpColumns columns;
+    columns.id = column("id");
+    columns.name = column("element") >= 0 ? column("element") : column("type");
+
+    // scaled coordinates first, they need no conversion at all
+    const char* sets[4][3] = {{"xs", "ys", "zs"}, {"xsu", "ysu", "zsu"}, {"x", "y", "z"}, {"xu", "yu", "zu"}};
+    for (int set = 0; set < 4 && columns.coord[0] < 0; set++) {
+        int found[3] = {column(sets[set][0]), column(sets[set][1]), column(sets[set][2])};
+        if (found[0] >= 0 && found[1] >= 0 && found[2] >= 0) {
+            std::copy(found, found + 3, columns.coord);
+            columns.scaled = set < 2;
+        }
+    }
+
+    if (columns.name < 0) {
+        throw std::runtime_error("LAMMPS dump has neither an element nor a type column.");
+    }
+    if (columns.coord[0] < 0) {
+        throw std::runtime_error("LAMMPS dump has no x y z, xu yu zu, xs ys zs or xsu ysu zsu columns.");
+    }
+    columns.used = 1 + std::max({columns.id, columns.name, columns.coord[0], columns.coord[1], columns.coord[2]});
+    return columns;
+}
+
+/**
+ * @brief Reads the box bounds lines into a box matrix with lattice vectors as columns
+ *
+ * @param[in] p Start of the first bounds line
+ * @param[in] triclinic True if the lines carry xy, xz and yz
+ * @return Position after the bounds, nullptr if the lines are truncated or invalid
+ */
+const char* parseBoxBounds(const char* p, const char* end, bool triclinic, double* matrix) {
+    double lo[3], hi[3], tilt[3] = {0, 0, 0};
+    for (int k = 0; k < 3; k++) {
+        if (p >= end) {
+            return nullptr;
+        }
+        const char* eol = textscan::lineEnd(p, end);
+        const char* q = textscan::parseDouble(p, eol, lo[k]);
+        q = q ? textscan::parseDouble(q, eol, hi[k]) : nullptr;
+        q = q && triclinic ? textscan::parseDouble(q, eol, tilt[k]) : q;
+        if (!q) {
+            throw std::runtime_error("Cannot read LAMMPS box bounds.");
+        }
+        p = textscan::nextLine(p, end);
+    }
+
+    // triclinic dumps give the bounding box, the box edges are recovered from the tilts
+    double xy = tilt[0], xz = tilt[1], yz = tilt[2];
+    double xlo = lo[0] - std::min({0.0, xy, xz, xy + xz});
+    double xhi = hi[0] - std::max({0.0, xy, xz, xy + xz});
+    double ylo = lo[1] - std::min(0.0, yz);
+    double yhi = hi[1] - std::max(0.0, yz);
+
+    double box[9] = {xhi - xlo, xy,        xz,
+                     0,         yhi - ylo, yz,
+                     0,         0,         hi[2] - lo[2]};
+    std::copy(box, box + 9, matrix);
+    return p;
+}
+
+} // namespace
+
+void System::readLAMMPS(const std::string &trajectory_file_name) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+
+    std::cout << "Parsing LAMMPS dump file: " + trajectory_file_name << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(trajectory_file_name);
+    const char* p = file.begin();
+    const char* end = file.end();
+
+    DumpColumns columns;
+    std::string atoms_header;
+    std::vector<int> id_index;              // Trajectory index of each atom id
+    std::vector<double> frame_box(9);
+    int frame = 0;
+    box_matrices.clear();
+    xyz_boxes.clear();
+    xyz_box_error.clear();
+
+    while (p < end) {
+        // frame header items up to ITEM: ATOMS
+        int frame_natoms = -1;
+        bool has_box = false;
+        const char* eol = textscan::lineEnd(p, end);
+        while (p < end && !startsWith(p, eol, "ITEM: ATOMS")) {
+            if (textscan::blankLine(p, eol)) {
+                // blank lines between frames
+            } else if (startsWith(p, eol, "ITEM: NUMBER OF ATOMS")) {
+                p = textscan::nextLine(p, end);
+                eol = textscan::lineEnd(p, end);
+                if (!textscan::parseInteger(p, eol, frame_natoms)) {
+                    throw std::runtime_error("Cannot read number of atoms of LAMMPS frame " + std::to_string(frame) + ".");
+                }
+            } else if (startsWith(p, eol, "ITEM: BOX BOUNDS")) {
+                bool triclinic = std::search(p, eol, "xy", "xy" + 2) != eol;
+                p = parseBoxBounds(textscan::nextLine(p, end), end, triclinic, frame_box.data());
+                if (!p) {
+                    break;
+                }
+                has_box = true;
+                eol = textscan::lineEnd(p, end);
+                continue;
+            } else if (startsWith(p, eol, "ITEM:")) {
+                // TIMESTEP, TIME and UNITS carry one value line
+                p = textscan::nextLine(p, end);
+            } else {
+                throw std::runtime_error("Unexpected line in header of LAMMPS frame " + std::to_string(frame) + ".");
+            }
+            p = textscan::nextLine(p, end);
+            eol = textscan::lineEnd(p, end);
+        }
+        if (!p || p >= end) {
+            break;
+        }
+        if (frame_natoms <= 0 || !has_box) {
+            throw std::runtime_error("LAMMPS frame " + std::to_string(frame)
+                                     + " lacks the number of atoms or the box bounds.");
+        }
+
+        // the first frame fixes columns and atom order
+        if (nframes == 0 && id_index.empty()) {
+            atoms_header.assign(p, eol);
+            columns = parseAtomsHeader(p + strlen("ITEM: ATOMS"), eol);
+            fractional = columns.scaled;
+
+            std::vector<long> ids;
+            std::vector<std::string> names;
+            const char* q = textscan::nextLine(p, end);
+            for (int j = 0; j < frame_natoms && q < end; j++) {
+                const char* line_end = textscan::lineEnd(q, end);
+                const char* r = q;
+                long id = j + 1;
+                for (int col = 0; col < columns.used; col++) {
+                    const char* token;
+                    size_t length;
+                    r = textscan::parseToken(r, line_end, token, length);
+                    if (col == columns.id) {
+                        textscan::parseInteger(token, token + length, id);
+                    } else if (col == columns.name) {
+                        names.emplace_back(token, length);
+                    }
+                }
+                ids.push_back(id);
+                q = textscan::nextLine(q, end);
+            }
+            if (static_cast<int>(ids.size()) < frame_natoms) {
+                break;
+            }
+
+            // trajectory order is by atom id, dumps may list atoms in any order
+            std::vector<int> order(frame_natoms);
+            for (int j = 0; j < frame_natoms; j++) {
+                order[j] = j;
+            }
+            std::sort(order.begin(), order.end(), [&ids](int a, int b) { return ids[a] < ids[b]; });
+            long max_id = ids[order.back()];
+            if (ids[order.front()] < 0 || max_id > 16L * frame_natoms + 1024) {
+                throw std::runtime_error("LAMMPS atom ids out of range.");
+            }
+            id_index.assign(max_id + 1, -1);
+            std::vector<std::string> trajectory_atoms(frame_natoms);
+            for (int t = 0; t < frame_natoms; t++) {
+                if (id_index[ids[order[t]]] >= 0) {
+                    throw std::runtime_error("Duplicate atom id " + std::to_string(ids[order[t]]) + " in LAMMPS dump.");
+                }
+                id_index[ids[order[t]]] = t;
+                trajectory_atoms[t] = names[order[t]];
+            }
+            setupAtoms(trajectory_atoms);
+        } else if (frame_natoms != natoms_total) {
+            throw std::runtime_error("Frame " + std::to_string(frame)
+                                     + " has a different number of atoms than the first frame.");
+        } else if (atoms_header.compare(0, std::string::npos, p, eol - p) != 0) {
+            throw std::runtime_error("Frame " + std::to_string(frame) + " has different atom columns than the first frame.");
+        }
+
+        p = textscan::nextLine(p, end);
+        if (!selection.contains(frame)) {
+            if (selection.finished(frame)) {
+                break;
+            }
+            p = textscan::skipLines(p, end, natoms_total);
+            frame++;
+            continue;
+        }
+
+        growTrajectoryMemory(nframes + 1);
+        double* frame_coords = frameBuffer(nframes);
+        int j = 0;
+        for (; j < natoms_total && p < end; j++) {
+            const char* line_end = textscan::lineEnd(p, end);
+            const char* q = p;
+            long id = j + 1;
+            double values[3];
+            const char* name = nullptr;
+            size_t name_length = 0;
+            for (int col = 0; col < columns.used; col++) {
+                const char* token;
+                size_t length;
+                q = textscan::parseToken(q, line_end, token, length);
+                if (length == 0) {
+                    throw std::runtime_error("Missing columns of atom " + std::to_string(j)
+                                             + " in frame " + std::to_string(frame) + ".");
+                }
+                if (col == columns.id) {
+                    textscan::parseInteger(token, token + length, id);
+                } else if (col == columns.name) {
+                    name = token;
+                    name_length = length;
+                }
+                for (int k = 0; k < 3; k++) {
+                    if (col == columns.coord[k] && !textscan::parseDouble(token, token + length, values[k])) {
+                        throw std::runtime_error("Cannot read coordinates of atom " + std::to_string(j)
+                                                 + " in frame " + std::to_string(frame) + ".");
+                    }
+                }
+            }
+
+            int index = (id >= 0 && id < static_cast<long>(id_index.size())) ? id_index[id] : -1;
+            if (index < 0) {
+                throw std::runtime_error("Unknown atom id " + std::to_string(id) + " in frame " + std::to_string(frame) + ".");
+            }
+            int slot = atom_slots[index];
+            if (slot >= 0) {
+                if (!species.matches(slot, name, name_length)) {
+                    std::cerr << "Frame " << frame << " has different atom name for atom id " << id << std::endl;
+                }
+                std::copy(values, values + 3, frame_coords + slot * 3);
+            }
+            p = textscan::nextLine(p, end);
+        }
+        if (j < natoms_total) {
+            std::cerr << "Truncated frame " << frame << " at end of trajectory is ignored." << std::endl;
+            break;
+        }
+
+        storeFrame(nframes, frame_coords);
+        box_matrices.insert(box_matrices.end(), frame_box.begin(), frame_box.end());
+        nframes++;
+        frame++;
+    }
+
+    if (nframes == 0) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reportThroughput(file.size(), elapsed.count());
+    if (fractional) {
+        std::cout << "Scaled coordinates are kept as fractional coordinates." << std::endl;
+    }
+    std::cout << "Trajectory file parsed successfully!" << std::endl;
+}
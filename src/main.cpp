@@ -1,12 +1,28 @@
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include "settings.h"
+#include "frame_index.h"
 #include "system.h"
 #include "rdf.h"
 
 int main(int argc, char** argv){
+    // MDTools index <trajectory.xyz|.xtc> only builds the frame index sidecar
+    if (argc == 3 && std::string(argv[1]) == "index") {
+        try {
+            FrameIndex index;
+            index.build(argv[2]);
+            index.write(indexFileName(argv[2]), argv[2]);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     if(argc != 2) {
-        std::cerr << "Usage: " << argv[0] << "<settings.json>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <settings.json>" << std::endl;
+        std::cerr << "       " << argv[0] << " index <trajectory.xyz|.xtc>" << std::endl;
         return 1;
     }
 
@@ -16,7 +32,7 @@ int main(int argc, char** argv){
         // Load settings and system info
         Settings settings(settings_file);
         System sys;
-        sys.readXYZ(settings.traj_infile);
+        sys.readTrajectory(settings);
         sys.readBox(settings);
 
         // Compute (i)RDFs
@@ -0,0 +1,67 @@
+/**
+ * @file mapped_file.cpp
+ * @brief POSIX memory mapping of input files and file version stamps
+ */
+
+#include <stdexcept>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "compressed_file.h"
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const std::string& filename, bool sequential) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file " + filename + ", please check if it exists.");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file " + filename);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    if (size_ > 0) {
+        void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot memory map file " + filename);
+        }
+        if (sequential) {
+            madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+        data_ = static_cast<const char*>(addr);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+
+    // compressed files are held decompressed, the mapping of the compressed bytes is released
+    Compression compression = detectCompression(data_, size_);
+    if (compression != Compression::none) {
+        try {
+            decompressed_ = decompress(data_, size_, compression);
+        } catch (const std::exception& e) {
+            munmap(const_cast<char*>(data_), size_);
+            throw std::runtime_error("Cannot decompress file " + filename + ": " + e.what());
+        }
+        munmap(const_cast<char*>(data_), size_);
+        data_ = decompressed_.empty() ? nullptr : decompressed_.data();
+        size_ = decompressed_.size();
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data_ && decompressed_.empty()) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+void fileStamp(const std::string& filename, uint64_t& size, int64_t& mtime) {
+    size = std::filesystem::file_size(filename);
+    mtime = std::filesystem::last_write_time(filename).time_since_epoch().count();
+}
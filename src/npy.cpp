@@ -0,0 +1,204 @@
+/**
+ * @file npy.cpp
+ * @brief NumPy .npy and .npz output
+ *
+ * .npy files hold a magic string, a Python dict literal giving type and shape,
+ * then the raw array bytes. .npz archives are zip files with one .npy entry per
+ * array; entries are stored uncompressed, with CRC-32 checksums from zlib.
+ */
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <zlib.h>
+#include "npy.h"
+
+namespace {
+
+/**
+ * @brief '<' on little endian hosts, '>' on big endian ones
+ */
+char byteOrder() {
+    uint16_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1 ? '<' : '>';
+}
+
+/**
+ * @brief The magic string, version and padded header dict of a .npy file
+ */
+std::string npyHeader(const NpyArray& array) {
+    std::string dict = "{'descr': '" + array.descr + "', 'fortran_order': False, 'shape': (";
+    for (size_t d = 0; d < array.shape.size(); d++) {
+        dict += std::to_string(array.shape[d]) + (array.shape.size() == 1 ? "," : d + 1 < array.shape.size() ? ", " : "");
+    }
+    dict += "), }";
+
+    // the data starts at a multiple of 64 bytes, the dict ends in a newline
+    const size_t prefix = 10;
+    size_t total = (prefix + dict.size() + 1 + 63) / 64 * 64;
+    dict.append(total - prefix - dict.size() - 1, ' ');
+    dict += '\n';
+    if (dict.size() > UINT16_MAX) {
+        throw std::runtime_error("Array " + array.name + " has too many dimensions for a .npy header.");
+    }
+
+    std::string header("\x93NUMPY\x01\x00", 8);
+    header += static_cast<char>(dict.size() & 0xff);
+    header += static_cast<char>(dict.size() >> 8);
+    return header + dict;
+}
+
+/**
+ * @brief Appends value as n little endian bytes, as zip fields are stored
+ */
+void putLE(std::string& out, uint32_t value, int n) {
+    for (int k = 0; k < n; k++) {
+        out += static_cast<char>((value >> (8 * k)) & 0xff);
+    }
+}
+
+/**
+ * @brief The CRC-32 of size bytes, continuing from crc
+ */
+uint32_t crc32Of(uint32_t crc, const char* data, size_t size) {
+    const Bytef* bytes = reinterpret_cast<const Bytef*>(data);
+    while (size > 0) {
+        uInt block = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+        crc = static_cast<uint32_t>(crc32(crc, bytes, block));
+        bytes += block;
+        size -= block;
+    }
+    return crc;
+}
+
+} // namespace
+
+NpyArray NpyArray::view(const std::string& name, const std::vector<double>& values, std::vector<size_t> shape) {
+    NpyArray array;
+    array.name = name;
+    array.descr = std::string(1, byteOrder()) + "f8";
+    array.shape = std::move(shape);
+    array.data = reinterpret_cast<const char*>(values.data());
+    array.nbytes = values.size() * sizeof(double);
+    return array;
+}
+
+NpyArray NpyArray::scalar(const std::string& name, double value) {
+    NpyArray array;
+    array.name = name;
+    array.descr = std::string(1, byteOrder()) + "f8";
+    array.owned.resize(sizeof(value));
+    memcpy(array.owned.data(), &value, sizeof(value));
+    array.data = array.owned.data();
+    array.nbytes = array.owned.size();
+    return array;
+}
+
+NpyArray NpyArray::scalar(const std::string& name, int64_t value) {
+    NpyArray array;
+    array.name = name;
+    array.descr = std::string(1, byteOrder()) + "i8";
+    array.owned.resize(sizeof(value));
+    memcpy(array.owned.data(), &value, sizeof(value));
+    array.data = array.owned.data();
+    array.nbytes = array.owned.size();
+    return array;
+}
+
+NpyArray NpyArray::text(const std::string& name, const std::string& value) {
+    // one UCS-4 code unit per character, names are plain ASCII
+    NpyArray array;
+    array.name = name;
+    array.descr = std::string(1, byteOrder()) + "U" + std::to_string(std::max<size_t>(value.size(), 1));
+    array.owned.assign(std::max<size_t>(value.size(), 1) * 4, 0);
+    for (size_t k = 0; k < value.size(); k++) {
+        uint32_t code = static_cast<unsigned char>(value[k]);
+        memcpy(&array.owned[k * 4], &code, 4);
+    }
+    array.data = array.owned.data();
+    array.nbytes = array.owned.size();
+    return array;
+}
+
+void writeNpy(const std::string& filename, const NpyArray& array) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to write NumPy output file " + filename);
+    }
+    std::string header = npyHeader(array);
+    file.write(header.data(), header.size());
+    file.write(array.data, array.nbytes);
+    if (!file) {
+        throw std::runtime_error("Failed to write NumPy output file " + filename);
+    }
+}
+
+void writeNpz(const std::string& filename, const std::vector<NpyArray>& arrays) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to write NumPy output file " + filename);
+    }
+
+    // local header and data of every entry, then the central directory
+    std::string directory;
+    uint64_t offset = 0;
+    for (const NpyArray& array : arrays) {
+        std::string header = npyHeader(array);
+        std::string entry_name = array.name + ".npy";
+        uint64_t size = header.size() + array.nbytes;
+        if (offset + size + 30 + entry_name.size() > UINT32_MAX) {
+            throw std::runtime_error("NumPy output " + filename + " exceeds the 4 GiB limit of .npz archives, "
+                                     "write .npy files instead.");
+        }
+        uint32_t crc = crc32Of(crc32Of(0, header.data(), header.size()), array.data, array.nbytes);
+
+        // version 2.0, stored, dated 1980-01-01
+        std::string fields;
+        putLE(fields, 20, 2);
+        putLE(fields, 0, 2);
+        putLE(fields, 0, 2);
+        putLE(fields, 0, 2);
+        putLE(fields, 0x21, 2);
+        putLE(fields, crc, 4);
+        putLE(fields, static_cast<uint32_t>(size), 4);
+        putLE(fields, static_cast<uint32_t>(size), 4);
+        putLE(fields, static_cast<uint32_t>(entry_name.size()), 2);
+        putLE(fields, 0, 2);
+
+        std::string local;
+        putLE(local, 0x04034b50, 4);
+        local += fields + entry_name;
+        file.write(local.data(), local.size());
+        file.write(header.data(), header.size());
+        file.write(array.data, array.nbytes);
+
+        putLE(directory, 0x02014b50, 4);
+        putLE(directory, 20, 2);
+        directory += fields;
+        putLE(directory, 0, 2);
+        putLE(directory, 0, 2);
+        putLE(directory, 0, 2);
+        putLE(directory, 0, 4);
+        putLE(directory, static_cast<uint32_t>(offset), 4);
+        directory += entry_name;
+        offset += local.size() + size;
+    }
+
+    std::string end;
+    putLE(end, 0x06054b50, 4);
+    putLE(end, 0, 2);
+    putLE(end, 0, 2);
+    putLE(end, static_cast<uint32_t>(arrays.size()), 2);
+    putLE(end, static_cast<uint32_t>(arrays.size()), 2);
+    putLE(end, static_cast<uint32_t>(directory.size()), 4);
+    putLE(end, static_cast<uint32_t>(offset), 4);
+    putLE(end, 0, 2);
+    file.write(directory.data(), directory.size());
+    file.write(end.data(), end.size());
+    if (!file) {
+        throw std::runtime_error("Failed to write NumPy output file " + filename);
+    }
+}
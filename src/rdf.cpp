@@ -14,10 +14,18 @@
 #include <stdexcept>
 #include <math.h>
 #include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
 #include "settings.h"
 #include "system.h"
 #include "tools.h"
 #include "pbc.h"
+#include "npy.h"
+#include "text_writer.h"
+#include "json.hpp"
 #include "rdf.h"
 
 constexpr double PI = 3.141592653589793238L;
@@ -46,21 +54,52 @@ void RDFCalculator::initializeVectors(const Settings& settings) {
 void RDFCalculator::compute(System& sys, const Settings& settings) {
     // initialize vectors from settings
     initializeVectors(settings);
-    num_A_ = 0;
-    num_B_ = 0;
-    pairs_ = generatePairs(sys, settings.atomA, settings.atomB, num_A_, num_B_);
-    factor_ = num_A_ * num_B_ * 4 * PI * dr_;
-
-    // calculate rdf and irdf
-    for (int frame = 0; frame < sys.nframes; frame++) {
-        sys.updateBoxInformation(frame);
-        calculateRDF(sys, settings, frame);
-
-        if (settings.increments > 0) {
-            calculateIncrementalRDF(sys, settings, frame);
+    selectAtoms(sys, settings.atomA, settings.atomB);
+    factor_ = static_cast<double>(num_A_) * num_B_ * 4 * PI * dr_;
+
+    // cell and Verlet lists find the pairs themselves
+    search_ = settings.neighbor_list == "cells"  ? PairSearch::cells
+            : settings.neighbor_list == "verlet" ? PairSearch::verlet : PairSearch::all;
+    r_max_ = settings.r_max;
+    verlet_skin_ = settings.verlet_skin;
+    wrap_fractional_ = settings.minimum_image == "fractional";
+    verlet_list_ = VerletList();
+    pairs_.clear();
+    if (search_ == PairSearch::all) {
+        pairs_ = generatePairs();
+    }
+
+    // calculate rdf and irdf, with the kernel for these settings picked once
+    const FrameKernel calculateFrame = selectFrameKernel(settings);
+    if (!sys.streaming && sys.frame_boxes.empty()) {
+        throw std::logic_error("No box information for the trajectory frames.");
+    }
+    if (sys.streaming) {
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> compute_time(0);
+
+        // streamed frames always occupy frame index 0
+        while (sys.nextFrame()) {
+            auto frame_start = std::chrono::steady_clock::now();
+            (this->*calculateFrame)(sys, settings, 0);
+            compute_time += std::chrono::steady_clock::now() - frame_start;
+        }
+        if (sys.nframes == 0) {
+            throw std::runtime_error("No frames read from trajectory stream.");
+        }
+
+        std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+        reportStreamTiming(sys, compute_time.count(), wall_time.count());
+    } else {
+        for (int frame = 0; frame < sys.nframes; frame++) {
+            (this->*calculateFrame)(sys, settings, frame);
         }
     }
 
+    if (search_ == PairSearch::verlet) {
+        reportVerletBuilds(sys.nframes);
+    }
+
     // normalize rdf and irdf vectors
     normalizeRDF(settings, sys.nframes);
     if (settings.increments > 0) {
@@ -69,85 +108,149 @@ void RDFCalculator::compute(System& sys, const Settings& settings) {
     //smoothRDF(settings);
 
     // write rdf and irdf outputs
+    if (settings.output_format != "text") {
+        writeNumpyOutput(settings, sys.nframes);
+        return;
+    }
     writeRDFOutput(settings);
     if (!settings.irdf_outfile.empty() && settings.increments > 0) {
         writeIncrementalRDFOutput(settings);
     }
 }
 
-void RDFCalculator::calculateRDF(System& sys, const Settings& settings, int frame) {
-    for(std::pair<int, int> &pair : pairs_) {
-        double dx = sys.coords[frame*sys.natoms * 3 + pair.first * 3]
-                  - sys.coords[frame*sys.natoms * 3 + pair.second * 3];
-        double dy = sys.coords[frame*sys.natoms * 3 + pair.first * 3 + 1]
-                  - sys.coords[frame*sys.natoms * 3 + pair.second * 3 + 1];
-        double dz = sys.coords[frame*sys.natoms * 3 + pair.first * 3 + 2]
-                  - sys.coords[frame*sys.natoms * 3 + pair.second * 3 + 2];
+void RDFCalculator::reportStreamTiming(const System& sys, double compute_seconds, double wall_seconds) const {
+    double read_seconds = sys.source->readSeconds();
+    double wait_seconds = sys.stream_wait_seconds;
+    double overlapped = read_seconds > 0 ? 100.0 * std::max(0.0, read_seconds - wait_seconds) / read_seconds : 0.0;
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3)
+           << "Streamed " << sys.nframes << " frames in " << wall_seconds << " s\n"
+           << "  read/parse:       " << read_seconds << " s\n"
+           << "  waiting on reads: " << wait_seconds << " s\n"
+           << "  compute:          " << compute_seconds << " s\n"
+           << std::setprecision(1)
+           << "  read time overlapped with compute: " << overlapped << " %";
+    std::cout << report.str() << std::endl;
+}
 
-        pbcTriclinic(dx, dy, dz, sys);
+void RDFCalculator::reportVerletBuilds(int nframes) const {
+    int builds = verlet_list_.builds();
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1)
+           << "Verlet list rebuilt " << builds << " times in " << nframes << " frames, every "
+           << (builds > 0 ? static_cast<double>(nframes) / builds : 0.0) << " frames on average.";
+    std::cout << report.str() << std::endl;
+}
 
-        double dAB = sqrt(dx * dx + dy * dy + dz * dz);
+template <typename Image, typename Visit>
+void RDFCalculator::visitPairs(const FrameBox& box, const Image& image, Visit&& visit) {
+    if (search_ == PairSearch::all) {
+        for (const std::pair<int, int>& pair : pairs_) {
+            visit(pair.first, image.distance(pair.first, pair.second));
+        }
+        return;
+    }
 
-        if(dAB < settings.r_max && dAB >= settings.r_min) {
-            int layer = static_cast<int>((dAB - settings.r_min) / dr_);
-            if (layer >= 0 && layer < settings.bins) {
-                //std::cout << sys.box_volume << std::endl;
-                g_[layer] += sys.box_volume; 
-            }
+    // candidates come from the lists, distances are computed as for all pairs
+    auto fraction = [&](int i, double* s) { image.fraction(i, s); };
+    if (search_ == PairSearch::verlet) {
+        verlet_list_.update(box, r_max_, verlet_skin_, atoms_A_, atoms_B_, fraction);
+        for (const std::pair<int, int>& pair : verlet_list_.pairs()) {
+            visit(pair.first, image.distance(pair.first, pair.second));
         }
+        return;
     }
 
+    cell_list_.build(box, r_max_, atoms_B_, fraction);
+    for (int a : atoms_A_) {
+        double s[3];
+        image.fraction(a, s);
+        cell_list_.forEachNeighbor(s, [&](int b) {
+            visit(a, image.distance(a, b));
+        });
+    }
 }
 
-void RDFCalculator::calculateIncrementalRDF(System& sys, const Settings& settings, int frame) {
+template <bool ZeroRMin, bool Incremental, typename Image>
+void RDFCalculator::histogramFrame(const FrameBox& box, const Image& image, const Settings& settings) {
+    const double r_min = settings.r_min;
+    const double r_max = settings.r_max;
+    const int bins = settings.bins;
+    const double dr = dr_;
+    const double volume = box.volume;
+    double* g = g_.data();
+    int atomA = -1;
     int count = 0;
-    int check = pairs_.empty() ? -1 : pairs_[0].first;
-
-    for(std::pair<int, int> &pair : pairs_) {
-        double dx = sys.coords[frame*sys.natoms * 3 + pair.first * 3]
-                  - sys.coords[frame*sys.natoms * 3 + pair.second * 3];
-        double dy = sys.coords[frame*sys.natoms * 3 + pair.first * 3 + 1]
-                  - sys.coords[frame*sys.natoms * 3 + pair.second * 3 + 1];
-        double dz = sys.coords[frame*sys.natoms * 3 + pair.first * 3 + 2]
-                  - sys.coords[frame*sys.natoms * 3 + pair.second * 3 + 2];
-
-        pbcTriclinic(dx, dy, dz, sys);
 
-        double dAB = sqrt(dx * dx + dy * dy + dz * dz);
-
-        if (check == pair.first) {
-            refreshMinAB(settings, dAB, count);
-        } else {
-            // if changed atomA index, load sorted minAB array to incre_g
-            std::sort(minAB_.begin(), minAB_.end());
-            for(int i = 0; i < settings.increments; i++) {
-                int layer = static_cast<int>((minAB_[i] -settings.r_min) / dr_);
-                if (layer >= 0 && layer < settings.bins) {
-                    incre_g_[layer + i*settings.bins] += sys.box_volume; 
-                }
+    visitPairs(box, image, [&](int a, double dAB) {
+        if (dAB < r_max && (ZeroRMin || dAB >= r_min)) {
+            int layer = static_cast<int>((ZeroRMin ? dAB : dAB - r_min) / dr);
+            if ((ZeroRMin || layer >= 0) && layer < bins) {
+                g[layer] += volume;
             }
+        }
 
-            for(int i = 0; i < settings.increments; i++) {
-                minAB_[i] = 0;
+        // the nearest distances of each A atom are binned once its pairs are done
+        if constexpr (Incremental) {
+            if (a != atomA) {
+                binMinAB(settings, volume, count);
+                atomA = a;
             }
+            refreshMinAB(settings, dAB, count);
         }
-        check = pair.first;
+    });
+    if constexpr (Incremental) {
+        binMinAB(settings, volume, count);
+    }
+}
+
+template <bool ZeroRMin, bool Incremental>
+void RDFCalculator::calculateFrame(System& sys, const Settings& settings, int frame) {
+    const FrameBox& box = sys.frameBox(frame);
+
+    // the box policy follows the storage of the frames and the shape of this box
+    if (sys.fixed_bits > 0) {
+        const int32_t* q = sys.fixedFrame(frame, fixed_buffer_);
+        histogramFrame<ZeroRMin, Incremental>(box, FixedPointImage(box, q, sys.fixed_bits), settings);
+        return;
+    }
+    const double* frame_coords = sys.frameCoords(frame, frame_buffer_);
+    if (sys.fractional) {
+        histogramFrame<ZeroRMin, Incremental>(box, FractionalImage(box, frame_coords), settings);
+    } else if (box.orthorhombic) {
+        histogramFrame<ZeroRMin, Incremental>(box, OrthorhombicImage(box, frame_coords), settings);
+    } else if (wrap_fractional_) {
+        fraction_buffer_.resize(static_cast<size_t>(sys.natoms) * 3);
+        toFractional(box, frame_coords, atoms_AB_, fraction_buffer_.data());
+        histogramFrame<ZeroRMin, Incremental>(box, FractionalImage(box, fraction_buffer_.data()), settings);
+    } else {
+        histogramFrame<ZeroRMin, Incremental>(box, TriclinicImage(box, frame_coords), settings);
+    }
+}
+
+RDFCalculator::FrameKernel RDFCalculator::selectFrameKernel(const Settings& settings) {
+    bool zero_r_min = settings.r_min == 0;
+    bool incremental = settings.increments > 0;
+    if (zero_r_min) {
+        return incremental ? &RDFCalculator::calculateFrame<true, true>
+                           : &RDFCalculator::calculateFrame<true, false>;
     }
+    return incremental ? &RDFCalculator::calculateFrame<false, true>
+                       : &RDFCalculator::calculateFrame<false, false>;
+}
 
-    std::sort(minAB_.begin(), minAB_.end());
-    for (int i = 0; i < settings.increments; i++) {
+void RDFCalculator::binMinAB(const Settings& settings, double volume, int& count) {
+    std::sort(minAB_.begin(), minAB_.begin() + count);
+    for (int i = 0; i < count; i++) {
         int layer = static_cast<int>((minAB_[i] - settings.r_min) / dr_);
         if (layer >= 0 && layer < settings.bins) {
-            incre_g_[layer + i*settings.bins] += sys.box_volume; 
+            incre_g_[layer + i*settings.bins] += volume;
         }
     }
-    
-    for(int i = 0; i < settings.increments; i++) {
-        minAB_[i] = 0.0;
-    }
+    count = 0;
 }
 
-
 void RDFCalculator::normalizeRDF(const Settings& settings, int nframes) {
     for (int i = 0; i < settings.bins; i++) {
         double r = settings.r_min + i * dr_;
@@ -175,39 +278,37 @@ void RDFCalculator::normalizeIncrementalRDF(const Settings& settings, int nframe
 
 
 void RDFCalculator::writeRDFOutput(const Settings& settings) const {
-    std::ofstream rdffile(settings.rdf_outfile);
+    TextWriter rdffile(settings.rdf_outfile);
     if (!rdffile.is_open()) {
         throw std::runtime_error("Failed to write RDF output file");
     }
 
-    rdffile << settings.bins << "  " << settings.atomA << "  " << settings.atomB << "\n";
-    rdffile << "distance:\tRDF value:\n";
+    rdffile.integer(settings.bins).text("  ").text(settings.atomA).text("  ").text(settings.atomB).character('\n');
+    rdffile.text("distance:\tRDF value:\n");
 
     for (int i = 0; i < settings.bins; i++) {
         double r = settings.r_min + i * dr_;
-        rdffile << std::fixed << std::setprecision(5) << r << "\t"
-                << std::fixed << std::setprecision(8) << g_[i] << "\n";
+        rdffile.fixed(r, 5).character('\t').fixed(g_[i], 8).character('\n');
     }
 
     rdffile.close();
 }
 
 void RDFCalculator::writeIncrementalRDFOutput(const Settings& settings) const {
-    std::ofstream irdffile(settings.irdf_outfile);
+    TextWriter irdffile(settings.irdf_outfile);
     if (!irdffile.is_open()) {
         throw std::runtime_error("Failed to write incremental RDF output file");
     }
 
-    irdffile << settings.bins << "  " << settings.atomA << "  " << settings.atomB << "\n";
+    irdffile.integer(settings.bins).text("  ").text(settings.atomA).text("  ").text(settings.atomB).character('\n');
 
     for (int i = 0; i < settings.increments; i++) {
-        irdffile << "iRDF: " << i << "\n";
-        irdffile << "distance:\tRDF value:\n";
+        irdffile.text("iRDF: ").integer(i).character('\n');
+        irdffile.text("distance:\tRDF value:\n");
 
         for (int j = 0; j < settings.bins; j++) {
             double r = settings.r_min + j * dr_;
-            irdffile << std::fixed << std::setprecision(5) << r << "\t"
-                     << std::fixed << std::setprecision(8) << incre_g_[j + i * settings.bins] << "\n";
+            irdffile.fixed(r, 5).character('\t').fixed(incre_g_[j + i * settings.bins], 8).character('\n');
         }
     }
 
@@ -232,34 +333,84 @@ void RDFCalculator::refreshMinAB(const Settings& settings, double dAB, int& coun
     }
 }
 
-std::vector<std::pair<int, int>> RDFCalculator::generatePairs(
-    const System& sys, const std::string &atomA, const std::string &atomB,
-    int &numA, int &numB) {
+void RDFCalculator::selectAtoms(const System& sys, const std::string& atomA, const std::string& atomB) {
+    // atoms are selected by species ID from the index lists built at load time
+    int typeA = sys.species.find(atomA);
+    int typeB = sys.species.find(atomB);
+    atoms_A_ = typeA >= 0 ? sys.species.atoms[typeA] : std::vector<int>();
+    atoms_B_ = typeB >= 0 ? sys.species.atoms[typeB] : std::vector<int>();
+    atoms_AB_.clear();
+    std::set_union(atoms_A_.begin(), atoms_A_.end(), atoms_B_.begin(), atoms_B_.end(),
+                   std::back_inserter(atoms_AB_));
+
+    num_A_ = static_cast<int>(atoms_A_.size());
+    num_B_ = static_cast<int>(atoms_B_.size());
+}
+
+std::vector<std::pair<int, int>> RDFCalculator::generatePairs() const {
     std::vector<std::pair<int, int>> pair_vector;
+    pair_vector.reserve(atoms_A_.size() * atoms_B_.size());
+    for (int a : atoms_A_) {
+        for (int b : atoms_B_) {
+            pair_vector.push_back(std::make_pair(a, b));
+        }
+    }
+    return pair_vector;
+}
 
-    for (int a = 0; a < sys.natoms; a++) {
-        if (sys.atoms[a] == atomA) {
-            numA++;
-        } else if(sys.atoms[a] == atomB) {
-            numB++;
+void RDFCalculator::writeNumpyOutput(const Settings& settings, int nframes) const {
+    std::vector<double> r(settings.bins);
+    for (int i = 0; i < settings.bins; i++) {
+        r[i] = settings.r_min + i * dr_;
+    }
+    bool irdf = !settings.irdf_outfile.empty() && settings.increments > 0;
+    size_t bins = settings.bins;
+    size_t increments = settings.increments;
+    auto renamed = [](const std::string& filename, const std::string& extension) {
+        return std::filesystem::path(filename).replace_extension(extension).string();
+    };
+
+    if (settings.output_format == "npz") {
+        std::vector<NpyArray> arrays;
+        arrays.push_back(NpyArray::view("r", r, {bins}));
+        arrays.push_back(NpyArray::view("g", g_, {bins}));
+        if (irdf) {
+            arrays.push_back(NpyArray::view("irdf", incre_g_, {increments, bins}));
         }
+        arrays.push_back(NpyArray::text("atom_type_1", settings.atomA));
+        arrays.push_back(NpyArray::text("atom_type_2", settings.atomB));
+        arrays.push_back(NpyArray::scalar("r_min", settings.r_min));
+        arrays.push_back(NpyArray::scalar("r_max", settings.r_max));
+        arrays.push_back(NpyArray::scalar("dr", dr_));
+        arrays.push_back(NpyArray::scalar("frames", static_cast<int64_t>(nframes)));
+        arrays.push_back(NpyArray::scalar("num_atom_1", static_cast<int64_t>(num_A_)));
+        arrays.push_back(NpyArray::scalar("num_atom_2", static_cast<int64_t>(num_B_)));
+        writeNpz(renamed(settings.rdf_outfile, ".npz"), arrays);
+        return;
     }
 
-    if (atomA == atomB) {
-        numB = numA;
+    // npy files hold arrays only, the metadata goes to a json file beside them
+    std::string stem = renamed(settings.rdf_outfile, "");
+    writeNpy(stem + ".npy", NpyArray::view("g", g_, {bins}));
+    writeNpy(stem + "_r.npy", NpyArray::view("r", r, {bins}));
+    if (irdf) {
+        writeNpy(renamed(settings.irdf_outfile, ".npy"), NpyArray::view("irdf", incre_g_, {increments, bins}));
     }
 
-    pair_vector.reserve(numA * numB);
-    for (int a = 0; a < sys.natoms; a++) {
-        if (sys.atoms[a] == atomA) {
-            for (int b = 0; b < sys.natoms; b++) {
-                if (sys.atoms[b] == atomB) {
-                    pair_vector.push_back(std::make_pair(a, b));
-                    //std::cout << "pairs: " << a << " , " << b << std::endl;
-                }
-            }
-        }
+    nlohmann::ordered_json metadata;
+    metadata["atom_type_1"] = settings.atomA;
+    metadata["atom_type_2"] = settings.atomB;
+    metadata["r_min"] = settings.r_min;
+    metadata["r_max"] = settings.r_max;
+    metadata["dr"] = dr_;
+    metadata["bins"] = settings.bins;
+    metadata["increments"] = irdf ? settings.increments : 0;
+    metadata["frames"] = nframes;
+    metadata["num_atom_1"] = num_A_;
+    metadata["num_atom_2"] = num_B_;
+    std::ofstream file(stem + ".json");
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to write RDF metadata file");
     }
-    return pair_vector;
+    file << metadata.dump(4) << "\n";
 }
-
@@ -10,6 +10,8 @@
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
+#include <thread>
+#include <algorithm>
 #include "json.hpp"
 using json = nlohmann::json;
 #include "settings.h"
@@ -44,12 +46,32 @@ void Settings::readSettings(const char* settingfile) {
 
         // optional configuration fields
         box_infile = settingconfig.value("box_input", std::string(""));
+        topology_infile = settingconfig.value("topology_input", std::string(""));
+        select_atoms = settingconfig.value("select_atoms", true);
         rdf_outfile = settingconfig.value("rdf_output", std::string("rdf.dat"));
         r_min = settingconfig.value("r_min", 0.0);
         r_max = settingconfig.value("r_max", 10.0);
         bins = settingconfig.value("bins", 200);
         increments = settingconfig.value("increment", 0);
         irdf_outfile = settingconfig.value("irdf_output", std::string("irdf.dat"));
+        output_format = settingconfig.value("output_format", std::string("text"));
+        neighbor_list = settingconfig.value("neighbor_list", std::string("none"));
+        verlet_skin = settingconfig.value("verlet_skin", 1.0);
+        minimum_image = settingconfig.value("minimum_image", std::string("cartesian"));
+        xyz_reader = settingconfig.value("xyz_reader", std::string("mmap"));
+        streaming = settingconfig.value("streaming", false);
+        prefetch_depth = settingconfig.value("prefetch_depth", 2);
+        trajectory_cache = settingconfig.value("trajectory_cache", false);
+        cache_precision = settingconfig.value("cache_precision", std::string("double"));
+        coord_precision = settingconfig.value("coord_precision", std::string("double"));
+        frame_index = settingconfig.value("frame_index", false);
+        frame_begin = settingconfig.value("frame_begin", 0);
+        frame_end = settingconfig.value("frame_end", -1);
+        frame_stride = settingconfig.value("frame_stride", 1);
+        threads = settingconfig.value("threads", 1);
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
 
         // verify setting parameters
         validateSettings();
@@ -79,5 +101,42 @@ void Settings::validateSettings() const {
     if (atomA.empty() || atomB.empty()) {
         throw std::runtime_error("Both atom types should be specified");
     }
+    if (cache_precision != "double" && cache_precision != "float") {
+        throw std::runtime_error("cache_precision should be either \"double\" or \"float\"");
+    }
+    if (coord_precision != "double" && coord_precision != "float"
+        && coord_precision != "fixed16" && coord_precision != "fixed21") {
+        throw std::runtime_error("coord_precision should be \"double\", \"float\", \"fixed16\" or \"fixed21\"");
+    }
+    if (prefetch_depth < 0) {
+        throw std::runtime_error("Prefetch depth must be non-negative");
+    }
+    if (frame_begin < 0) {
+        throw std::runtime_error("frame_begin must be non-negative");
+    }
+    if (frame_end >= 0 && frame_end <= frame_begin) {
+        throw std::runtime_error("frame_end must be greater than frame_begin, or -1 for all frames");
+    }
+    if (frame_stride <= 0) {
+        throw std::runtime_error("frame_stride must be positive");
+    }
+    if (threads < 0) {
+        throw std::runtime_error("Number of threads must be non-negative");
+    }
+    if (output_format != "text" && output_format != "npy" && output_format != "npz") {
+        throw std::runtime_error("output_format should be \"text\", \"npy\" or \"npz\"");
+    }
+    if (neighbor_list != "cells" && neighbor_list != "verlet" && neighbor_list != "none") {
+        throw std::runtime_error("neighbor_list should be \"cells\", \"verlet\" or \"none\"");
+    }
+    if (verlet_skin <= 0) {
+        throw std::runtime_error("verlet_skin must be positive");
+    }
+    if (minimum_image != "cartesian" && minimum_image != "fractional") {
+        throw std::runtime_error("minimum_image should be either \"cartesian\" or \"fractional\"");
+    }
+    if (xyz_reader != "mmap" && xyz_reader != "stream") {
+        throw std::runtime_error("xyz_reader should be either \"mmap\" or \"stream\"");
+    }
 }
 
@@ -0,0 +1,56 @@
+/**
+ * @file species.cpp
+ * @brief Interning of atom names into species IDs
+ */
+
+#include <stdexcept>
+#include <unordered_map>
+#include "species.h"
+
+void SpeciesTable::assign(const std::vector<std::string>& atom_names) {
+    clear();
+    types.resize(atom_names.size());
+
+    std::unordered_map<std::string, uint16_t> index;
+    for (size_t j = 0; j < atom_names.size(); j++) {
+        auto found = index.find(atom_names[j]);
+        if (found == index.end()) {
+            if (names.size() > UINT16_MAX) {
+                throw std::runtime_error("Too many distinct atom names, at most 65536 are supported.");
+            }
+            found = index.emplace(atom_names[j], static_cast<uint16_t>(names.size())).first;
+            names.push_back(atom_names[j]);
+            atoms.emplace_back();
+        }
+        types[j] = found->second;
+        atoms[found->second].push_back(static_cast<int>(j));
+    }
+}
+
+void SpeciesTable::assign(const std::vector<std::string>& species_names, const uint16_t* atom_types, int count) {
+    clear();
+    names = species_names;
+    types.assign(atom_types, atom_types + count);
+    atoms.resize(names.size());
+    for (int j = 0; j < count; j++) {
+        if (types[j] >= names.size()) {
+            throw std::runtime_error("Invalid species ID " + std::to_string(types[j]) + " of atom " + std::to_string(j) + ".");
+        }
+        atoms[types[j]].push_back(j);
+    }
+}
+
+int SpeciesTable::find(const std::string& name) const {
+    for (size_t t = 0; t < names.size(); t++) {
+        if (names[t] == name) {
+            return static_cast<int>(t);
+        }
+    }
+    return -1;
+}
+
+void SpeciesTable::clear() {
+    names.clear();
+    types.clear();
+    atoms.clear();
+}
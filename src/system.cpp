@@ -3,7 +3,7 @@
  * @brief System constructed from trajectory and box information
  * 
  * Atomic system built from MD trajectory information files.
- * Currently only reads xyz trajectory.
+ * Reads xyz, DCD, XTC and LAMMPS dump trajectories.
  */
 
 #include <fstream>
@@ -13,27 +13,197 @@
 #include <iostream>
 #include <math.h>
 #include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include "trajectory_cache.h"
+#include "compressed_file.h"
+#include "extxyz.h"
+#include "topology.h"
+#include "dcd.h"
+#include "xtc.h"
 #include "system.h"
 
-System::~System() {
-    delete[] atoms;
+namespace {
+
+/**
+ * @brief Copies the rows of frames into a new coordinate array
+ */
+template <typename T>
+T* copyFrames(const T* coords, const std::vector<int>& frames, size_t frame_size) {
+    T* selected = new T[frames.size() * frame_size];
+    for (size_t i = 0; i < frames.size(); i++) {
+        std::copy(coords + frames[i] * frame_size, coords + (frames[i] + 1) * frame_size,
+                  selected + i * frame_size);
+    }
+    return selected;
+}
+
+/**
+ * @brief Copies the atoms at indices of every frame into a new coordinate array
+ */
+template <typename T>
+T* copyAtoms(const T* coords, int nframes, int natoms_total, const std::vector<int>& indices) {
+    size_t natoms = indices.size();
+    T* selected = new T[static_cast<size_t>(nframes) * natoms * 3];
+    for (int frame = 0; frame < nframes; frame++) {
+        const T* frame_coords = coords + static_cast<size_t>(frame) * natoms_total * 3;
+        T* selected_coords = selected + static_cast<size_t>(frame) * natoms * 3;
+        for (size_t i = 0; i < natoms; i++) {
+            std::copy(frame_coords + indices[i] * 3, frame_coords + indices[i] * 3 + 3, selected_coords + i * 3);
+        }
+    }
+    return selected;
+}
+
+/**
+ * @brief Moves the first frames of coords into a new array with room for capacity frames
+ */
+template <typename T>
+T* growFrames(T* coords, size_t used, size_t capacity) {
+    T* grown = new T[capacity];
+    std::copy(coords, coords + used, grown);
     delete[] coords;
+    return grown;
+}
+
+} // namespace
+
+System::~System() {
+    releaseCoordinates();
     delete[] boxes;
 }
 
 void System::allocateTrajectoryMemory() {
     if (traj_allocated) {
-        delete[] atoms;
-        delete[] coords;
+        releaseCoordinates();
     }
 
     // TODO: assumes each frame contains same atoms in same sequence
-    atoms  = new std::string[natoms]; 
-    coords = new double[nframes * natoms * 3];
+    frame_capacity = std::max(nframes, 1);
+    if (single_precision) {
+        coords_single = new float[static_cast<size_t>(frame_capacity) * natoms * 3];
+    } else {
+        coords = new double[static_cast<size_t>(frame_capacity) * natoms * 3];
+    }
 
     traj_allocated = true;
 }
 
+void System::growTrajectoryMemory(int min_frames) {
+    if (min_frames <= frame_capacity) {
+        return;
+    }
+
+    // geometric growth keeps the number of copies logarithmic in nframes
+    int new_capacity = std::max(min_frames, 2 * frame_capacity);
+    size_t used = static_cast<size_t>(nframes) * natoms * 3;
+    size_t capacity = static_cast<size_t>(new_capacity) * natoms * 3;
+    if (single_precision) {
+        coords_single = growFrames(coords_single, used, capacity);
+    } else {
+        coords = growFrames(coords, used, capacity);
+    }
+    frame_capacity = new_capacity;
+}
+
+void System::encodeFixedPoint(int bits) {
+    if (bits != 16 && bits != 21) {
+        throw std::logic_error("Fixed-point coordinates have 16 or 21 bits.");
+    }
+    const uint32_t scale = 1u << bits;
+    const size_t frame_size = static_cast<size_t>(natoms) * 3;
+    if (bits == 16) {
+        coords_fixed16.resize(static_cast<size_t>(nframes) * frame_size);
+    } else {
+        coords_fixed21.resize(static_cast<size_t>(nframes) * natoms);
+    }
+
+    std::vector<double> buffer;
+    for (int frame = 0; frame < nframes; frame++) {
+        const double* box_inverse = frameBox(frame).inverse;
+        const double* frame_coords = frameCoords(frame, buffer);
+        for (int i = 0; i < natoms; i++) {
+            const double* r = frame_coords + i * 3;
+            uint64_t packed = 0;
+            for (int k = 0; k < 3; k++) {
+                double fraction = fractional ? r[k]
+                                : box_inverse[k * 3] * r[0] + box_inverse[k * 3 + 1] * r[1] + box_inverse[k * 3 + 2] * r[2];
+                fraction -= floor(fraction);
+                uint32_t q = static_cast<uint32_t>(llround(fraction * scale)) & (scale - 1);
+                if (bits == 16) {
+                    coords_fixed16[frame * frame_size + i * 3 + k] = static_cast<uint16_t>(q);
+                } else {
+                    packed |= static_cast<uint64_t>(q) << (21 * k);
+                }
+            }
+            if (bits == 21) {
+                coords_fixed21[static_cast<size_t>(frame) * natoms + i] = packed;
+            }
+        }
+    }
+
+    releaseCoordinates();
+    single_precision = false;
+    fixed_bits = bits;
+    std::cout << "Coordinates are stored as " << bits << "-bit fixed-point fractions, "
+              << (bits == 16 ? 6 : 8) << " bytes per atom." << std::endl;
+}
+
+const int32_t* System::fixedFrame(int frame, std::vector<int32_t>& buffer) const {
+    buffer.resize(static_cast<size_t>(natoms) * 3);
+    if (fixed_bits == 16) {
+        const uint16_t* frame_coords = coords_fixed16.data() + static_cast<size_t>(frame) * natoms * 3;
+        std::copy(frame_coords, frame_coords + buffer.size(), buffer.begin());
+    } else {
+        const uint64_t* frame_coords = coords_fixed21.data() + static_cast<size_t>(frame) * natoms;
+        for (int i = 0; i < natoms; i++) {
+            for (int k = 0; k < 3; k++) {
+                buffer[i * 3 + k] = static_cast<int32_t>((frame_coords[i] >> (21 * k)) & 0x1fffff);
+            }
+        }
+    }
+    return buffer.data();
+}
+
+void System::releaseCoordinates() {
+    if (!coords_map) {
+        delete[] coords;
+        delete[] coords_single;
+    }
+    coords = nullptr;
+    coords_single = nullptr;
+    coords_map.reset();
+}
+
+double* System::frameBuffer(int frame) {
+    if (!single_precision) {
+        return coords + static_cast<size_t>(frame) * natoms * 3;
+    }
+    thread_local std::vector<double> scratch;
+    scratch.resize(static_cast<size_t>(natoms) * 3);
+    return scratch.data();
+}
+
+void System::storeFrame(int frame, const double* frame_coords) {
+    if (single_precision) {
+        std::copy(frame_coords, frame_coords + static_cast<size_t>(natoms) * 3,
+                  coords_single + static_cast<size_t>(frame) * natoms * 3);
+    }
+}
+
+const double* System::frameCoords(int frame, std::vector<double>& buffer) const {
+    if (fixed_bits > 0) {
+        throw std::logic_error("Fixed-point frames are read with fixedFrame.");
+    }
+    if (!single_precision) {
+        return coords + static_cast<size_t>(frame) * natoms * 3;
+    }
+    const float* frame_coords = coords_single + static_cast<size_t>(frame) * natoms * 3;
+    buffer.assign(frame_coords, frame_coords + static_cast<size_t>(natoms) * 3);
+    return buffer.data();
+}
+
 void System::allocateBoxMemory() {
     if (box_allocated) {
         delete[] boxes;
@@ -49,14 +219,11 @@ void System::allocateBoxMemory() {
         boxes = new double[nframes * 6];
     }
 
-    box_matrix  = new double[9];
-    box_inverse = new double[9];
-
     box_allocated = true;
 }
 
 void System::readXYZ(const std::string &trajectory_file_name) {
-    if (atoms || coords) {
+    if (!species.empty() || coords) {
         throw std::logic_error("Coordinates already in System instance.");
         return;
     }
@@ -65,79 +232,248 @@ void System::readXYZ(const std::string &trajectory_file_name) {
         throw std::runtime_error("Trajectory file is not specified, please include an xyz file.");
     }
     
-    std::ifstream file(trajectory_file_name);
+    InputFile file(trajectory_file_name);
     if (!file.is_open()) {
         throw std::runtime_error("Cannot open trajectory file, please check if it exists.");
     }
 
     std::cout << "Parsing trajectory file: " + trajectory_file_name << std::endl;
+    auto start = std::chrono::steady_clock::now();
 
-    // set natoms and nframes
+    // single pass: atoms, coords and comment line boxes are filled frame by frame
     std::string line;
+    std::string atom_name;
+    std::vector<std::string> atom_names;
     std::istringstream iss;
-    iss.clear();
+    int xyz_box_format = -1;
+    int frame = 0;
+    bool lattice = false;
+    xyz_boxes.clear();
+    xyz_box_error.clear();
+    box_matrices.clear();
 
-    std::getline(file, line);
-    iss.str(line);
-    iss >> natoms;
+    while (std::getline(file, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
 
-    nframes++;
-    while(std::getline(file, line)) {
-        nframes++;
-    }
-    nframes /= (natoms + 2);
+        int frame_natoms = 0;
+        iss.clear();
+        iss.str(line);
+        iss >> frame_natoms;
 
-    file.clear();
-    file.seekg(0);
-    allocateTrajectoryMemory();
+        // frames outside the selection are skipped by counting lines only
+        if (selection.finished(frame)) {
+            break;
+        }
+        if (!selection.contains(frame)) {
+            for (int j = 0; j < frame_natoms + 1; j++) {
+                file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            frame++;
+            continue;
+        }
 
-    // set atoms and coords
-    for (int i = 0; i < nframes; i++) {
-        std::getline(file, line);
-        std::getline(file, line);
+        if (nframes == 0) {
+            natoms = frame_natoms;
+            if (natoms <= 0) {
+                throw std::runtime_error("Invalid number of atoms in trajectory file header.");
+            }
+            allocateTrajectoryMemory();
+            atom_names.resize(natoms);
+        } else if (frame_natoms != natoms) {
+            throw std::runtime_error("Frame " + std::to_string(nframes)
+                                     + " has a different number of atoms than the first frame.");
+        }
+
+        // comment line carries the box of this frame, if any
+        if (!std::getline(file, line)) {
+            break;
+        }
+        double matrix[9];
+        const char* comment_end = line.data() + line.size();
+        if (nframes == 0) {
+            XYZColumns columns;
+            std::vector<AtomProperty> properties;
+            if (parseProperties(line.data(), comment_end, columns, properties) && !columns.plain()) {
+                throw std::runtime_error("Extended xyz columns other than species pos need xyz_reader \"mmap\".");
+            }
+            if (!properties.empty()) {
+                std::cerr << "Extra extended xyz columns are only read by xyz_reader \"mmap\"." << std::endl;
+            }
+            lattice = parseLattice(line.data(), comment_end, matrix);
+        }
+        if (lattice) {
+            if (!parseLattice(line.data(), comment_end, matrix)) {
+                throw std::runtime_error("Frame " + std::to_string(frame) + " has no Lattice in its comment line.");
+            }
+            box_matrices.insert(box_matrices.end(), matrix, matrix + 9);
+        } else if (xyz_box_error.empty()) {
+            try {
+                std::vector<double> box_params = parseBoxLine(line, xyz_box_format);
+                xyz_boxes.insert(xyz_boxes.end(), box_params.begin(), box_params.end());
+            } catch (const std::exception& e) {
+                xyz_box_error = "Frame " + std::to_string(nframes) + ": " + e.what();
+                xyz_boxes.clear();
+            }
+        }
 
-        for (int j = 0; j < natoms; j++) {
-            std::istringstream tempiss;
-            std::string dummy_atom;
-            tempiss.clear();
+        growTrajectoryMemory(nframes + 1);
+        double* frame_coords = frameBuffer(nframes);
 
-            std::getline(file, line);
-            tempiss.str(line);
+        int j = 0;
+        for (; j < natoms && std::getline(file, line); j++) {
+            iss.clear();
+            iss.str(line);
+            iss >> atom_name >> frame_coords[j * 3] >> frame_coords[j * 3 + 1] >> frame_coords[j * 3 + 2];
 
-            if (i == 0) {
-                tempiss >> atoms[j];
-            } else {
-                tempiss >> dummy_atom;
-            }
-            
-            tempiss.clear();
-            tempiss.str(line);
-            tempiss >> dummy_atom
-                    >> coords[i * natoms * 3 + j * 3]
-                    >> coords[i * natoms * 3 + j * 3 + 1]
-                    >> coords[i * natoms * 3 + j * 3 + 2];
-
-            if (dummy_atom != atoms[j] && i != 0) {
-                std::cerr << "atomname" << dummy_atom << "  atoms[j]" << atoms[j] << std::endl;
-                std::cerr << "Frame " << i << " has different atom name at index " << j << std::endl;
+            if (nframes == 0) {
+                atom_names[j] = atom_name;
+            } else if (atom_name != atom_names[j]) {
+                std::cerr << "Frame " << nframes << " has different atom name at index " << j << std::endl;
             }
         }
+
+        if (j < natoms) {
+            std::cerr << "Truncated frame " << nframes << " at end of trajectory is ignored." << std::endl;
+            break;
+        }
+        storeFrame(nframes, frame_coords);
+        nframes++;
+        frame++;
     }
 
-    file.close();
+    // throughput of the text parsed, not of the compressed file
+    size_t bytes = file.bytesRead();
+
+    if (nframes == 0) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+    box_matrices.resize(lattice ? static_cast<size_t>(nframes) * 9 : 0);
+    if (!xyz_box_error.empty() || lattice) {
+        xyz_boxes.clear();
+    } else {
+        xyz_boxes.resize(static_cast<size_t>(nframes) * 6);
+    }
     
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reportThroughput(bytes, elapsed.count());
     std::cout << "Trajectory file parsed successfully!" << std::endl;
 
+    // the line reader keeps every atom, dropped atoms are removed afterwards
+    species.assign(atom_names);
+    applyAtomSelection();
+}
+
+void System::openTrajectory(const Settings& settings) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+
+    std::cout << "Streaming trajectory file: " + settings.traj_infile << std::endl;
+    if (isLAMMPSDump(settings.traj_infile)) {
+        throw std::runtime_error("LAMMPS dump files cannot be streamed, set streaming to false.");
+    }
+    // binary frames are read from a mapping, which holds a compressed file whole in memory
+    if ((hasExtension(settings.traj_infile, ".dcd") || hasExtension(settings.traj_infile, ".xtc"))
+        && fileCompression(settings.traj_infile) != Compression::none) {
+        throw std::runtime_error("Compressed DCD and XTC files cannot be streamed, decompress them"
+                                 " or set streaming to false.");
+    }
+    if (hasExtension(settings.traj_infile, ".dcd")) {
+        if (settings.topology_infile.empty()) {
+            throw std::runtime_error("DCD trajectories need a topology_input naming the atoms.");
+        }
+        source = std::make_unique<DCDFrameSource>(settings.traj_infile, readAtomNames(settings.topology_infile),
+                                                  selection, atom_selection);
+    } else if (hasExtension(settings.traj_infile, ".xtc")) {
+        if (settings.topology_infile.empty()) {
+            throw std::runtime_error("XTC trajectories need a topology_input naming the atoms.");
+        }
+        source = std::make_unique<XTCFrameSource>(settings.traj_infile, readAtomNames(settings.topology_infile),
+                                                  selection, atom_selection);
+    } else {
+        source = std::make_unique<XYZFrameSource>(settings.traj_infile, selection, atom_selection);
+    }
+    if (settings.prefetch_depth > 0) {
+        source = std::make_unique<PrefetchFrameSource>(std::move(source), settings.prefetch_depth);
+    }
+
+    streaming = true;
+    natoms = source->natoms();
+    natoms_total = source->natomsTotal();
+    atom_indices = source->atomIndices();
+    nframes = 0;
+    allocateTrajectoryMemory();
+    species.assign(source->atomNames());
+
+    // a single box slot, refreshed for every frame
+    fixed_volume = true;
+    allocateBoxMemory();
+    fixed_volume = false;
+    box_matrices.assign(source->boxSize() == 9 ? 9 : 0, 0.0);
+    stream_box_built.clear();
+}
+
+bool System::nextFrame() {
+    bool boxes_from_file = !stream_boxes.empty();
+    int nboxes = static_cast<int>(stream_boxes.size() / 6);
+
+    auto start = std::chrono::steady_clock::now();
+    double* frame_box = box_matrices.empty() ? boxes : box_matrices.data();
+    bool frame_read = source->readFrame(coords, boxes_from_file ? nullptr : frame_box);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stream_wait_seconds += elapsed.count();
+
+    if (!frame_read) {
+        if (boxes_from_file && nboxes != 1 && nboxes != nframes && !selection.active()) {
+            throw std::logic_error("Box entries not matching trajectory frame numbers");
+        }
+        return false;
+    }
+
+    // box file rows belong to trajectory frames, selected or not
+    if (boxes_from_file) {
+        int row = (nboxes == 1) ? 0 : selection.trajectoryFrame(nframes);
+        if (row >= nboxes) {
+            throw std::logic_error("Box entries not matching trajectory frame numbers");
+        }
+        std::copy(&stream_boxes[row * 6], &stream_boxes[row * 6] + 6, boxes);
+    }
+
+    // fixed boxes and repeated box rows reuse the table entry of the previous frame
+    size_t nvalues = box_matrices.empty() ? 6 : 9;
+    if (stream_box_built.size() != nvalues || !std::equal(frame_box, frame_box + nvalues, stream_box_built.begin())) {
+        buildBoxTable(1);
+        stream_box_built.assign(frame_box, frame_box + nvalues);
+    }
+
+    nframes++;
+    return true;
 }
 
 void System::readBox(const Settings& settings) {
     bool box_read = false;
+
+    // streamed frames carry their boxes in the comment lines unless a box file is given
+    if (streaming) {
+        if (!settings.box_infile.empty()) {
+            std::cout << "Reading box from file: " << settings.box_infile << std::endl;
+            stream_boxes = readBoxLines(settings.box_infile);
+            box_matrices.clear();
+        }
+        std::cout << "Box setup complete!" << std::endl;
+        return;
+    }
     
-    // read from separate box file if specified
-    if (!settings.box_infile.empty()) {
+    // scaled coordinates only make sense in the box of their own frame
+    if (fractional && !settings.box_infile.empty()) {
+        std::cerr << "Trajectory holds scaled coordinates, box_input is ignored." << std::endl;
+    } else if (!settings.box_infile.empty()) {
         try {
             std::cout << "Attempting to read box from file: " << settings.box_infile << std::endl;
             readBoxFromFile(settings.box_infile);
+            box_matrices.clear();
             box_read = true;
             std::cout << "Successfully read box information from separate file." << std::endl;
         } catch (const std::exception& e) {
@@ -150,7 +486,7 @@ void System::readBox(const Settings& settings) {
     if (!box_read) {
         try {
             std::cout << "Attempting to read box from XYZ file: " << settings.traj_infile << std::endl;
-            readBoxFromXYZ(settings.traj_infile);
+            readBoxFromXYZ();
             box_read = true;
             std::cout << "Successfully read box information from XYZ file." << std::endl;
         } catch (const std::exception& e) {
@@ -161,234 +497,394 @@ void System::readBox(const Settings& settings) {
     if (!box_read) {
         std::cerr << "No box information found. Please verify box information in trajectory or in box file" << std::endl;
     }
+
+    if (box_read) {
+        buildBoxTable(settings.threads);
+    }
+
+    // fixed-point fractions are relative to the box of their frame
+    if (box_read && settings.coord_precision.compare(0, 5, "fixed") == 0) {
+        encodeFixedPoint(settings.coord_precision == "fixed16" ? 16 : 21);
+    }
     
     std::cout << "Box setup complete!" << std::endl;
 }
 
-void System::readBoxFromXYZ(const std::string &trajectory_file_name) {
-    if (trajectory_file_name.empty()) {
-        throw std::runtime_error("Trajectory file is not specified, please include an xyz file.");
-    }
-    
-    std::ifstream file(trajectory_file_name);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open trajectory file, please check if it exists.");
+void System::readBoxFromXYZ() {
+    if (!box_matrices.empty()) {
+        fixed_volume = (box_matrices.size() == 9);
+        allocateBoxMemory();
+        return;
     }
 
-    std::vector<std::vector<double>> box_data;
-    std::string line;
+    if (!xyz_box_error.empty()) {
+        throw std::runtime_error(xyz_box_error);
+    }
 
-    for (int i = 0; i < nframes; i++) {
-        getline(file, line);
-        getline(file, line);
-        std::istringstream iss(line);
+    if (xyz_boxes.empty()) {
+        throw std::runtime_error("No valid box data found in trajectory comment lines.");
+    }
 
-        // box_format: -1: unknown, 3: orthogonal, 6: triclinic
-        int box_format = -1;
-        std::vector<double> temp_params;
-        double value;
+    storeBoxData(xyz_boxes);
+}
 
-        while (iss >> value) {
-            temp_params.push_back(value);
-        }
+void System::readBoxFromFile(const std::string &box_file_name) {
+    std::vector<double> box_data = readBoxLines(box_file_name);
 
-        if (box_format == -1) {
-            if (temp_params.size() == 3) {
-                box_format = 3;
-            } else if (temp_params.size() == 6) {
-                box_format = 6;
-            } else {
-                throw std::runtime_error(std::string("Box can either take 3 parameters (a, b, c) for orthorhombic box")
-                                        + " or 6 parameters (a, b, c, A, B, C) for triclinic box in a line.");
-            }
-        } else {
-            if (static_cast<int>(temp_params.size()) != box_format) {
-                throw std::runtime_error("Box format in consistent to the first frame!");
-            }
+    // box file rows belong to trajectory frames, selected or not
+    if (selection.active() && box_data.size() > 6) {
+        int last_row = selection.trajectoryFrame(nframes - 1);
+        if (static_cast<int>(box_data.size() / 6) <= last_row) {
+            throw std::logic_error("Box entries not matching trajectory frame numbers");
         }
+        box_data = selection.apply(box_data, 6);
+        box_data.resize(static_cast<size_t>(nframes) * 6);
+    }
+    storeBoxData(box_data);
+}
 
-        std::vector<double> box_params(6);
-        if (box_format == 3) {
-            box_params[0] = temp_params[0];
-            box_params[1] = temp_params[1];
-            box_params[2] = temp_params[2];
-            box_params[3] = 90;
-            box_params[4] = 90;
-            box_params[5] = 90;
-        } else {
-            box_params = temp_params;
-        }
+std::vector<double> System::readBoxLines(const std::string &box_file_name) {
+    if (box_file_name.empty()) {
+        throw std::runtime_error("Box file is not specified, please include a box file.");
+    }
+    
+    InputFile file(box_file_name);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open box file, please check if it exists.");
+    }
 
-        //validateBoxParams(box_params); //TODO
-        box_data.push_back(box_params);
+    std::vector<double> box_data;
+    std::string line;
+    // box_format: -1: unknown, 3: orthogonal, 6: triclinic
+    int box_format = -1;
 
-        for (int j = 0; j < natoms; j++) {
-            getline(file, line);
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
         }
-    }
 
-    file.close();
+        std::vector<double> box_params = parseBoxLine(line, box_format);
+        box_data.insert(box_data.end(), box_params.begin(), box_params.end());
+    }
 
     if (box_data.empty()) {
         throw std::runtime_error("No valid box data found in file.");
     }
+    return box_data;
+}
 
-    fixed_volume = (box_data.size() == 1);
-    allocateBoxMemory();
+std::vector<double> System::parseBoxLine(const std::string& line, int& box_format) {
+    std::istringstream iss(line);
+    std::vector<double> temp_params;
+    double value;
 
-    if (fixed_volume) {
-        for (int i = 0; i < 6; i++) {
-            boxes[i] = box_data[0][i];
+    while (iss >> value) {
+        temp_params.push_back(value);
+    }
+
+    std::vector<double> box_params(6);
+    expandBoxParams(temp_params.data(), static_cast<int>(temp_params.size()), box_format, box_params.data());
+    return box_params;
+}
+
+void System::expandBoxParams(const double* values, int count, int& box_format, double* box_params) {
+    if (box_format == -1) {
+        if (count == 3) {
+            box_format = 3;
+        } else if (count == 6) {
+            box_format = 6;
+        } else {
+            throw std::runtime_error(std::string("Box can either take 3 parameters (a, b, c) for orthorhombic box")
+                                    + " or 6 parameters (a, b, c, A, B, C) for triclinic box in a line.");
         }
     } else {
-        if (static_cast<int>(box_data.size()) != nframes) {
-            throw std::logic_error("Box entries not matching trajectory frame numbers");
+        if (count != box_format) {
+            throw std::runtime_error("Box format in consistent to the first line!");
         }
+    }
 
-        for (int frame = 0; frame < nframes; frame++) {
-            for (int i = 0; i < 6; i++) {
-                boxes[frame * 6 + i] = box_data[frame][i];
-            }
-        }
+    for (int i = 0; i < 3; i++) {
+        box_params[i] = values[i];
+        box_params[i + 3] = (box_format == 3) ? 90 : values[i + 3];
     }
 
+    //validateBoxParams(box_params); //TODO
 }
 
-void System::readBoxFromFile(const std::string &box_file_name) {
-    if (box_file_name.empty()) {
-        throw std::runtime_error("Box file is not specified, please include a box file.");
-    }
-    
-    std::ifstream file(box_file_name);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open box file, please check if it exists.");
+void System::reportThroughput(size_t bytes, double seconds) {
+    double megabytes = bytes / (1024.0 * 1024.0);
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1) << "Parsed " << megabytes << " MB in "
+           << std::setprecision(3) << seconds << " s ("
+           << std::setprecision(1) << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s)";
+    std::cout << report.str() << std::endl;
+}
+
+namespace {
+
+/**
+ * @brief Reads the frame index sidecar of a trajectory, or builds and writes it
+ */
+FrameIndex loadFrameIndex(const std::string& trajectory_file_name) {
+    FrameIndex index;
+    std::string index_file_name = indexFileName(trajectory_file_name);
+    if (index.read(index_file_name, trajectory_file_name)) {
+        return index;
     }
 
-    std::vector<std::vector<double>> box_data;
-    std::string line;
-    // box_format: -1: unknown, 3: orthogonal, 6: triclinic
-    int box_format = -1;
+    std::cout << "Building frame index of " << trajectory_file_name << std::endl;
+    index.build(trajectory_file_name);
+    index.write(index_file_name, trajectory_file_name);
+    return index;
+}
 
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') {
-            continue;
-        }
+} // namespace
 
-        std::istringstream iss(line);
-        std::vector<double> temp_params;
-        double value;
+void System::readTrajectory(const Settings& settings) {
+    selection.begin = settings.frame_begin;
+    selection.end = settings.frame_end;
+    selection.stride = settings.frame_stride;
 
-        while (iss >> value) {
-            temp_params.push_back(value);
+    AtomSelection requested;
+    if (settings.select_atoms) {
+        requested.species = {settings.atomA};
+        if (settings.atomB != settings.atomA) {
+            requested.species.push_back(settings.atomB);
         }
+    }
+    atom_selection = requested;
 
-        if (box_format == -1) {
-            if (temp_params.size() == 3) {
-                box_format = 3;
-            } else if (temp_params.size() == 6) {
-                box_format = 6;
-            } else {
-                throw std::runtime_error(std::string("Box can either take 3 parameters (a, b, c) for orthorhombic box")
-                                        + " or 6 parameters (a, b, c, A, B, C) for triclinic box in a line.");
-            }
+    if (settings.streaming) {
+        openTrajectory(settings);
+        reportAtomSelection();
+        return;
+    }
+
+    // a streamed frame is a single buffer, only stored trajectories are kept in single precision
+    // fixed-point frames are staged in single precision until their boxes are read
+    single_precision = (settings.coord_precision != "double");
+    if (settings.coord_precision == "float") {
+        std::cout << "Coordinates are stored in single precision." << std::endl;
+    }
+
+    // dcd and xtc files take their atom names from the topology file
+    std::string cache_file_name = cacheFileName(settings.traj_infile);
+    bool named_by_topology = hasExtension(settings.traj_infile, ".dcd") || hasExtension(settings.traj_infile, ".xtc");
+    std::string cache_topology = named_by_topology ? settings.topology_infile : std::string();
+    int cache_precision = settings.cache_precision == "float" ? 4 : 8;
+    if (settings.trajectory_cache && readCache(cache_file_name, settings.traj_infile, cache_topology, cache_precision)) {
+        applyFrameSelection();
+        applyAtomSelection();
+        reportAtomSelection();
+        return;
+    }
+
+    // caches and indices describe the whole trajectory
+    bool write_cache = settings.trajectory_cache && !selection.active();
+    if (write_cache) {
+        atom_selection = AtomSelection();
+    }
+
+    if (isLAMMPSDump(settings.traj_infile)) {
+        readLAMMPS(settings.traj_infile);
+    } else if (hasExtension(settings.traj_infile, ".dcd")) {
+        // fixed size frames, located without any index
+        readDCD(settings.traj_infile, settings.topology_infile, settings.threads);
+    } else if (hasExtension(settings.traj_infile, ".xtc")) {
+        // frame offsets come from one pass over the frame headers, or from the sidecar
+        FrameIndex index;
+        if (settings.frame_index) {
+            index = loadFrameIndex(settings.traj_infile);
         } else {
-            if (static_cast<int>(temp_params.size()) != box_format) {
-                throw std::runtime_error("Box file format in consistent to the first line!");
-            }
+            index.buildXTC(settings.traj_infile);
         }
+        readXTC(settings.traj_infile, settings.topology_infile, index, settings.threads);
+    } else if (settings.frame_index && settings.xyz_reader == "mmap" && selection.active()) {
+        // the selected frames are reached by seeking through the frame index
+        FrameIndex index = loadFrameIndex(settings.traj_infile);
+        readXYZIndexed(settings.traj_infile, index, settings.threads);
+    } else if (settings.xyz_reader == "stream") {
+        readXYZ(settings.traj_infile);
+    } else if (settings.threads > 1) {
+        readXYZParallel(settings.traj_infile, settings.threads);
+    } else {
+        readXYZMapped(settings.traj_infile);
+    }
 
-        std::vector<double> box_params(6);
-        if (box_format == 3) {
-            box_params[0] = temp_params[0];
-            box_params[1] = temp_params[1];
-            box_params[2] = temp_params[2];
-            box_params[3] = 90;
-            box_params[4] = 90;
-            box_params[5] = 90;
-        } else {
-            box_params = temp_params;
+    if (write_cache) {
+        writeCache(cache_file_name, settings.traj_infile, cache_topology, cache_precision);
+        atom_selection = requested;
+        applyAtomSelection();
+    }
+    reportAtomSelection();
+
+    if (selection.active()) {
+        return;
+    }
+
+    // offsets recorded during the parse give the index for free
+    if (settings.frame_index && !frame_offsets.empty()) {
+        FrameIndex index;
+        std::string index_file_name = indexFileName(settings.traj_infile);
+        if (!index.read(index_file_name, settings.traj_infile)) {
+            index.natoms = natoms_total;
+            index.offsets.assign(frame_offsets.begin(), frame_offsets.end());
+            index.write(index_file_name, settings.traj_infile);
         }
+    }
+}
 
-        //validateBoxParams(box_params); //TODO
-        box_data.push_back(box_params);
+void System::applyFrameSelection() {
+    if (!selection.active()) {
+        return;
+    }
 
+    std::vector<int> frames;
+    for (int frame = selection.begin; frame < nframes && !selection.finished(frame); frame += selection.stride) {
+        frames.push_back(frame);
+    }
+    if (frames.empty()) {
+        throw std::logic_error("No frames in the requested range, the trajectory has "
+                               + std::to_string(nframes) + " frames.");
     }
 
-    file.close();
+    size_t frame_size = static_cast<size_t>(natoms) * 3;
+    if (single_precision) {
+        float* selected = copyFrames(coords_single, frames, frame_size);
+        releaseCoordinates();
+        coords_single = selected;
+    } else {
+        double* selected = copyFrames(coords, frames, frame_size);
+        releaseCoordinates();
+        coords = selected;
+    }
+    if (xyz_box_error.empty()) {
+        xyz_boxes = selection.apply(xyz_boxes, 6);
+    }
+    box_matrices = selection.apply(box_matrices, 9);
+    for (AtomProperty& property : atom_properties) {
+        property.values = selection.apply(property.values, static_cast<size_t>(natoms) * property.size);
+    }
+    nframes = static_cast<int>(frames.size());
+    frame_capacity = nframes;
+}
 
-    if (box_data.empty()) {
-        throw std::runtime_error("No valid box data found in file.");
+void System::setupAtoms(const std::vector<std::string>& trajectory_atoms) {
+    natoms_total = static_cast<int>(trajectory_atoms.size());
+    atom_slots = atom_selection.slots(trajectory_atoms, atom_indices);
+    if (atom_indices.empty()) {
+        throw std::runtime_error("None of the selected atom types is in the trajectory.");
     }
 
-    fixed_volume = (box_data.size() == 1);
-    allocateBoxMemory();
+    natoms = static_cast<int>(atom_indices.size());
+    allocateTrajectoryMemory();
+    std::vector<std::string> names(natoms);
+    for (int i = 0; i < natoms; i++) {
+        names[i] = trajectory_atoms[atom_indices[i]];
+    }
+    species.assign(names);
+}
 
-    if (fixed_volume) {
-        for (int i = 0; i < 6; i++) {
-            boxes[i] = box_data[0][i];
-        }
+void System::applyAtomSelection() {
+    std::vector<std::string> trajectory_atoms(natoms);
+    for (int i = 0; i < natoms; i++) {
+        trajectory_atoms[i] = species.name(i);
+    }
+    natoms_total = natoms;
+    atom_slots = atom_selection.slots(trajectory_atoms, atom_indices);
+    if (atom_indices.size() == trajectory_atoms.size()) {
+        return;
+    }
+    if (atom_indices.empty()) {
+        throw std::runtime_error("None of the selected atom types is in the trajectory.");
+    }
+
+    natoms = static_cast<int>(atom_indices.size());
+    if (single_precision) {
+        float* selected = copyAtoms(coords_single, nframes, natoms_total, atom_indices);
+        releaseCoordinates();
+        coords_single = selected;
     } else {
-        if (static_cast<int>(box_data.size()) != nframes) {
-            throw std::logic_error("Box entries not matching trajectory frame numbers");
-        }
+        double* selected = copyAtoms(coords, nframes, natoms_total, atom_indices);
+        releaseCoordinates();
+        coords = selected;
+    }
+    frame_capacity = nframes;
 
-        for (int frame = 0; frame < nframes; frame++) {
-            for (int i = 0; i < 6; i++) {
-                boxes[frame * 6 + i] = box_data[frame][i];
-            }
+    std::vector<std::string> names(natoms);
+    for (int i = 0; i < natoms; i++) {
+        names[i] = trajectory_atoms[atom_indices[i]];
+    }
+    species.assign(names);
+
+    for (AtomProperty& property : atom_properties) {
+        std::vector<double> values(static_cast<size_t>(nframes) * natoms * property.size);
+        for (size_t row = 0; row < static_cast<size_t>(nframes) * natoms; row++) {
+            size_t frame = row / natoms;
+            size_t line = frame * natoms_total + atom_indices[row % natoms];
+            std::copy(&property.values[line * property.size], &property.values[(line + 1) * property.size],
+                      &values[row * property.size]);
         }
+        property.values.swap(values);
     }
+}
 
+void System::reportAtomProperties() const {
+    if (atom_properties.empty()) {
+        return;
+    }
+    std::cout << "Extended xyz columns read:";
+    for (const AtomProperty& property : atom_properties) {
+        std::cout << " " << property.name << "(" << property.size << ")";
+    }
+    std::cout << std::endl;
 }
 
-void System::updateBoxInverse() {
-    for (int i = 0; i < 3; i++) {
-         for (int j = 0; j < 3; j++) {
-             box_inverse[i * 3 + j] = ((box_matrix[3 * ((j + 1) % 3) + (i + 1) % 3]  * 
-                                   box_matrix[3 * ((j + 2) % 3) + (i + 2) % 3]) -
-                                  (box_matrix[3 * ((j + 1) % 3) + (i + 2) % 3]  *
-                                   box_matrix[3 * ((j + 2) % 3) + (i + 1) % 3])) 
-                                  / box_volume;
-         }
-    }
-
-    return;
-}
-
-void System::updateBoxInformation(int frame) {
-    double PI = 3.141592653589793238L;
-    double radian_to_degree = PI / 180;
-
-    // update box information only if volume not fixed or first frame if fixed volume
-    if (!fixed_volume || frame == 0) {
-        // update box_matrix
-        box_matrix[0] = boxes[6 * frame];
-        box_matrix[1] = boxes[6 * frame + 1] * cos(boxes[6 * frame + 5] * radian_to_degree);
-        box_matrix[2] = boxes[6 * frame + 2] * cos(boxes[6 * frame + 4] * radian_to_degree);
-        box_matrix[3] = 0;
-        box_matrix[4] = boxes[6 * frame + 1] * sin(boxes[6 * frame + 5] * radian_to_degree);
-        box_matrix[5] = (boxes[6 * frame + 1] * boxes[6 * frame + 2] * cos(boxes[6 * frame + 3]
-                      * radian_to_degree) - box_matrix[1] * box_matrix[2]) / box_matrix[4];
-        box_matrix[6] = 0;
-        box_matrix[7] = 0;
-        box_matrix[8] = sqrt(boxes[6 * frame + 2] * boxes[6 * frame + 2] 
-                      - box_matrix[2] * box_matrix[2] - box_matrix[5] * box_matrix[5]);
-
-        // update box_volume
-        box_volume = 0;
-        for (int i = 0; i < 3; i++) {
-            box_volume += box_matrix[i] *
-                         (box_matrix[3 + (i + 1) % 3] * box_matrix[6 + (i + 2) % 3] -
-                          box_matrix[3 + (i + 2) % 3] * box_matrix[6 + (i + 1) % 3]);
-        }
+void System::reportAtomSelection() const {
+    if (natoms_total > natoms) {
+        std::cout << "Keeping " << natoms << " of " << natoms_total << " atoms per frame." << std::endl;
+    }
+}
 
-        if (box_volume <= 0) {
-            throw std::logic_error("PBC box volume should be positive!");
-        }
+void System::storeBoxData(const std::vector<double>& box_data) {
+    int nboxes = static_cast<int>(box_data.size() / 6);
 
-        // update box_inverse
-        updateBoxInverse();
-        
+    if (nboxes == 0) {
+        throw std::runtime_error("No valid box data found in file.");
     }
+
+    fixed_volume = (nboxes == 1);
+    if (!fixed_volume && nboxes != nframes) {
+        throw std::logic_error("Box entries not matching trajectory frame numbers");
+    }
+
+    allocateBoxMemory();
+    std::copy(box_data.begin(), box_data.begin() + nboxes * 6, boxes);
 }
 
+void System::buildBoxTable(int threads) {
+    int nboxes = (streaming || fixed_volume) ? 1 : nframes;
+    frame_boxes.resize(nboxes);
+    std::vector<std::string> errors(nboxes);
+
+    #pragma omp parallel for num_threads(threads)
+    for (int frame = 0; frame < nboxes; frame++) {
+        try {
+            double matrix[9];
+            if (box_matrices.empty()) {
+                boxMatrixFromParameters(&boxes[6 * frame], matrix);
+            } else {
+                std::copy(&box_matrices[9 * frame], &box_matrices[9 * frame] + 9, matrix);
+            }
+            frame_boxes[frame] = makeFrameBox(matrix);
+        } catch (const std::exception& e) {
+            errors[frame] = "Frame " + std::to_string(frame) + ": " + e.what();
+        }
+    }
+
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            throw std::logic_error(error);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+/**
+ * @file text_writer.cpp
+ * @brief Block buffered text output
+ */
+
+#include <stdexcept>
+#include "text_writer.h"
+
+TextWriter::TextWriter(const std::string& filename) : file_(filename) {
+    buffer_.reserve(BLOCK_SIZE);
+}
+
+void TextWriter::flush() {
+    file_.write(buffer_.data(), buffer_.size());
+    if (!file_) {
+        throw std::runtime_error("Failed to write output file");
+    }
+    buffer_.clear();
+}
+
+void TextWriter::close() {
+    flush();
+    file_.close();
+}
+
+std::string TextWriter::longFixed(double value, int precision) {
+    std::vector<char> digits(320 + precision);
+    std::to_chars_result result = std::to_chars(digits.data(), digits.data() + digits.size(), value,
+                                                std::chars_format::fixed, precision);
+    return std::string(digits.data(), result.ptr);
+}
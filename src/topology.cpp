@@ -0,0 +1,95 @@
+/**
+ * @file topology.cpp
+ * @brief Atom names for trajectory formats that only store coordinates
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "compressed_file.h"
+#include "topology.h"
+
+namespace {
+
+std::string trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+std::vector<std::string> readPDBNames(std::istream& file) {
+    std::vector<std::string> names;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, 6, "ATOM  ") != 0 && line.compare(0, 6, "HETATM") != 0) {
+            if (line.compare(0, 3, "END") == 0 && !names.empty()) {
+                break;
+            }
+            continue;
+        }
+
+        // element symbol in columns 77-78, atom name in columns 13-16
+        std::string name = line.size() > 76 ? trim(line.substr(76, 2)) : "";
+        if (name.empty() && line.size() > 12) {
+            name = trim(line.substr(12, 4));
+        }
+        if (name.empty()) {
+            throw std::runtime_error("PDB record " + std::to_string(names.size() + 1) + " has no atom name.");
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+std::vector<std::string> readXYZNames(std::istream& file) {
+    std::string line;
+    int natoms = 0;
+    if (!std::getline(file, line) || !(std::istringstream(line) >> natoms) || natoms <= 0) {
+        throw std::runtime_error("Invalid number of atoms in topology file header.");
+    }
+    std::getline(file, line);
+
+    std::vector<std::string> names(natoms);
+    for (int j = 0; j < natoms; j++) {
+        if (!std::getline(file, line) || !(std::istringstream(line) >> names[j])) {
+            throw std::runtime_error("Topology file holds fewer than " + std::to_string(natoms) + " atoms.");
+        }
+    }
+    return names;
+}
+
+} // namespace
+
+bool hasExtension(const std::string& filename, const std::string& extension) {
+    auto endsWith = [](const std::string& name, const std::string& suffix) {
+        return name.size() >= suffix.size()
+               && std::equal(suffix.begin(), suffix.end(), name.end() - suffix.size(),
+                             [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); });
+    };
+
+    // traj.xyz.gz is an xyz file to every reader
+    for (const char* compressed : {".gz", ".zst"}) {
+        if (endsWith(filename, compressed) && extension != compressed) {
+            return endsWith(filename.substr(0, filename.size() - strlen(compressed)), extension);
+        }
+    }
+    return endsWith(filename, extension);
+}
+
+std::vector<std::string> readAtomNames(const std::string& filename) {
+    InputFile file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open topology file " + filename);
+    }
+
+    std::vector<std::string> names = hasExtension(filename, ".pdb") ? readPDBNames(file) : readXYZNames(file);
+    if (names.empty()) {
+        throw std::runtime_error("No atoms found in topology file " + filename);
+    }
+    return names;
+}
@@ -0,0 +1,246 @@
+/**
+ * @file trajectory_cache.cpp
+ * @brief Binary trajectory cache
+ *
+ * After the first text parse the System is written to a compact binary cache.
+ * Later runs map the cache instead of parsing, double precision coordinates
+ * are then used straight from the mapping without any copy.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include "mapped_file.h"
+#include "trajectory_cache.h"
+#include "system.h"
+
+namespace {
+
+uint64_t alignOffset(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+void padTo(std::ofstream& file, uint64_t offset) {
+    static const char zeros[64] = {};
+    uint64_t position = static_cast<uint64_t>(file.tellp());
+    file.write(zeros, static_cast<std::streamsize>(offset - position));
+}
+
+void topologyStamp(const std::string& topology_file_name, uint64_t& size, int64_t& mtime) {
+    size = 0;
+    mtime = 0;
+    if (!topology_file_name.empty()) {
+        fileStamp(topology_file_name, size, mtime);
+    }
+}
+
+} // namespace
+
+bool System::readCache(const std::string& cache_file_name, const std::string& source_file_name,
+                       const std::string& topology_file_name, int precision) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::exists(cache_file_name, ec)) {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto map = std::make_unique<MappedFile>(cache_file_name, false);
+
+    CacheHeader header;
+    if (map->size() < sizeof(header)) {
+        std::cerr << "Trajectory cache " << cache_file_name << " is truncated, re-parsing trajectory." << std::endl;
+        return false;
+    }
+    memcpy(&header, map->data(), sizeof(header));
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    fileStamp(source_file_name, source_size, source_mtime);
+    uint64_t topology_size;
+    int64_t topology_mtime;
+    topologyStamp(topology_file_name, topology_size, topology_mtime);
+
+    if (memcmp(header.magic, "MDTCACHE", 8) != 0 || header.version != CACHE_VERSION
+        || header.byte_order != CACHE_BYTE_ORDER
+        || (header.precision != 4 && header.precision != 8)) {
+        std::cerr << "Trajectory cache " << cache_file_name << " has an unknown format, re-parsing trajectory." << std::endl;
+        return false;
+    }
+    if (header.source_size != source_size || header.source_mtime != source_mtime
+        || header.topology_size != topology_size || header.topology_mtime != topology_mtime
+        || header.precision != static_cast<uint32_t>(precision)) {
+        std::cout << "Trajectory cache " << cache_file_name << " is stale, re-parsing trajectory." << std::endl;
+        return false;
+    }
+
+    uint64_t ncoords = static_cast<uint64_t>(header.nframes) * header.natoms * 3;
+    int box_row_size = (header.flags & CACHE_BOX_MATRICES) ? 9 : 6;
+    if (header.boxes_offset + header.nbox_rows * box_row_size * sizeof(double) > map->size()
+        || header.coords_offset + ncoords * header.precision > map->size()
+        || header.types_offset + header.natoms * sizeof(uint16_t) > map->size()) {
+        std::cerr << "Trajectory cache " << cache_file_name << " is truncated, re-parsing trajectory." << std::endl;
+        return false;
+    }
+
+    // atom type table of NUL-terminated names up to types_offset, then one type index per atom
+    std::vector<std::string> type_names;
+    const char* name = map->data() + sizeof(header);
+    const char* names_end = map->data() + header.types_offset;
+    for (int t = 0; t < header.ntypes; t++) {
+        const char* terminator = name < names_end
+            ? static_cast<const char*>(std::memchr(name, '\0', names_end - name)) : nullptr;
+        if (terminator == nullptr) {
+            std::cerr << "Trajectory cache " << cache_file_name << " has a corrupt type table, re-parsing trajectory." << std::endl;
+            return false;
+        }
+        type_names.emplace_back(name, terminator);
+        name = terminator + 1;
+    }
+
+    std::cout << "Reading trajectory cache: " << cache_file_name << std::endl;
+    natoms = header.natoms;
+    nframes = header.nframes;
+    frame_capacity = nframes;
+
+    const uint16_t* types = reinterpret_cast<const uint16_t*>(map->data() + header.types_offset);
+    for (int j = 0; j < natoms; j++) {
+        if (types[j] >= type_names.size()) {
+            throw std::runtime_error("Invalid atom type in trajectory cache " + cache_file_name);
+        }
+    }
+    species.assign(type_names, types, natoms);
+
+    // coordinates in the precision of the storage are used in place
+    const char* cached = map->data() + header.coords_offset;
+    if (single_precision && header.precision == sizeof(float)) {
+        coords_single = reinterpret_cast<float*>(const_cast<char*>(cached));
+        coords_map = std::move(map);
+    } else if (single_precision) {
+        coords_single = new float[ncoords];
+        const double* cached_coords = reinterpret_cast<const double*>(cached);
+        std::copy(cached_coords, cached_coords + ncoords, coords_single);
+    } else if (header.precision == sizeof(double)) {
+        coords = reinterpret_cast<double*>(const_cast<char*>(cached));
+        coords_map = std::move(map);
+    } else {
+        const float* cached_coords = reinterpret_cast<const float*>(cached);
+        coords = new double[ncoords];
+        std::copy(cached_coords, cached_coords + ncoords, coords);
+    }
+    traj_allocated = true;
+
+    const double* cached_boxes = reinterpret_cast<const double*>(
+        (coords_map ? coords_map->data() : map->data()) + header.boxes_offset);
+    if (header.flags & CACHE_BOX_MATRICES) {
+        box_matrices.assign(cached_boxes, cached_boxes + header.nbox_rows * 9);
+    } else {
+        xyz_boxes.assign(cached_boxes, cached_boxes + header.nbox_rows * 6);
+        xyz_box_error = header.nbox_rows ? "" : "Trajectory comment lines hold no box information.";
+    }
+    fractional = (header.flags & CACHE_FRACTIONAL) != 0;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Trajectory cache read in " << elapsed.count() << " s ("
+              << nframes << " frames, " << natoms << " atoms)" << std::endl;
+    return true;
+}
+
+void System::writeCache(const std::string& cache_file_name, const std::string& source_file_name,
+                        const std::string& topology_file_name, int precision) const {
+    if (precision != 4 && precision != 8) {
+        throw std::logic_error("Trajectory cache precision must be 4 or 8 bytes.");
+    }
+    // a cache hit would silently drop the extra columns of extended xyz files
+    if (!atom_properties.empty()) {
+        std::cout << "Trajectory cache not written, it cannot hold extended xyz columns." << std::endl;
+        return;
+    }
+
+    // the species table is the atom type table, in order of first appearance
+    const std::vector<std::string>& type_names = species.names;
+    const std::vector<uint16_t>& types = species.types;
+
+    CacheHeader header{};
+    memcpy(header.magic, "MDTCACHE", 8);
+    header.version = CACHE_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.precision = precision;
+    header.natoms = natoms;
+    header.nframes = nframes;
+    header.ntypes = static_cast<int32_t>(type_names.size());
+    const std::vector<double>& box_rows = box_matrices.empty() ? xyz_boxes : box_matrices;
+    header.flags = (box_matrices.empty() ? 0 : CACHE_BOX_MATRICES) | (fractional ? CACHE_FRACTIONAL : 0);
+    header.nbox_rows = box_matrices.empty() ? (xyz_box_error.empty() ? static_cast<int32_t>(xyz_boxes.size() / 6) : 0)
+                                            : static_cast<int32_t>(box_matrices.size() / 9);
+    fileStamp(source_file_name, header.source_size, header.source_mtime);
+    topologyStamp(topology_file_name, header.topology_size, header.topology_mtime);
+
+    uint64_t names_size = 0;
+    for (const std::string& type_name : type_names) {
+        names_size += type_name.size() + 1;
+    }
+    uint64_t ncoords = static_cast<uint64_t>(nframes) * natoms * 3;
+    header.types_offset = alignOffset(sizeof(header) + names_size, 8);
+    header.coords_offset = alignOffset(header.types_offset + natoms * sizeof(uint16_t), 64);
+    header.boxes_offset = alignOffset(header.coords_offset + ncoords * precision, 8);
+
+    // written under a temporary name so a crash never leaves a valid looking cache
+    std::string temporary_name = cache_file_name + ".tmp";
+    std::ofstream file(temporary_name, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Cannot write trajectory cache " << cache_file_name << ", continuing without." << std::endl;
+        return;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::string& type_name : type_names) {
+        file.write(type_name.c_str(), static_cast<std::streamsize>(type_name.size() + 1));
+    }
+    padTo(file, header.types_offset);
+    file.write(reinterpret_cast<const char*>(types.data()), natoms * sizeof(uint16_t));
+    padTo(file, header.coords_offset);
+
+    if (precision == sizeof(double) && !single_precision) {
+        file.write(reinterpret_cast<const char*>(coords), static_cast<std::streamsize>(ncoords * sizeof(double)));
+    } else if (precision == sizeof(float) && single_precision) {
+        file.write(reinterpret_cast<const char*>(coords_single), static_cast<std::streamsize>(ncoords * sizeof(float)));
+    } else if (precision == sizeof(double)) {
+        std::vector<double> block;
+        for (int frame = 0; frame < nframes; frame++) {
+            const double* frame_coords = frameCoords(frame, block);
+            file.write(reinterpret_cast<const char*>(frame_coords),
+                       static_cast<std::streamsize>(static_cast<size_t>(natoms) * 3 * sizeof(double)));
+        }
+    } else {
+        std::vector<float> block(static_cast<size_t>(natoms) * 3);
+        for (int frame = 0; frame < nframes; frame++) {
+            const double* frame_coords = coords + static_cast<size_t>(frame) * natoms * 3;
+            std::copy(frame_coords, frame_coords + block.size(), block.begin());
+            file.write(reinterpret_cast<const char*>(block.data()),
+                       static_cast<std::streamsize>(block.size() * sizeof(float)));
+        }
+    }
+    padTo(file, header.boxes_offset);
+    file.write(reinterpret_cast<const char*>(box_rows.data()),
+               header.nbox_rows * (box_matrices.empty() ? 6 : 9) * sizeof(double));
+    file.close();
+
+    std::error_code ec;
+    if (file) {
+        std::filesystem::rename(temporary_name, cache_file_name, ec);
+    }
+    if (!file || ec) {
+        std::cerr << "Cannot write trajectory cache " << cache_file_name << ", continuing without." << std::endl;
+        std::filesystem::remove(temporary_name, ec);
+        return;
+    }
+    std::cout << "Trajectory cache written: " << cache_file_name << std::endl;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file verlet_list.cpp
+ * @brief Verlet neighbor lists reused over frames
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <iterator>
+#include "verlet_list.h"
+
+double VerletList::strain(const FrameBox& box) const {
+    const double* h0 = reference_box_.matrix;
+    double norm2 = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            double m = h0[i * 3] * box.inverse[j] + h0[i * 3 + 1] * box.inverse[3 + j]
+                     + h0[i * 3 + 2] * box.inverse[6 + j] - (i == j ? 1.0 : 0.0);
+            norm2 += m * m;
+        }
+    }
+    return sqrt(norm2);
+}
+
+void VerletList::imageRange(const FrameBox& box, double cutoff, int* range) {
+    // an image n steps away along lattice vector k is at least (|n| - 1/2) plane spacings away
+    for (int k = 0; k < 3; k++) {
+        const double* row = box.inverse + 3 * k;
+        double width = 1.0 / sqrt(row[0] * row[0] + row[1] * row[1] + row[2] * row[2]);
+        range[k] = static_cast<int>(floor(cutoff / width + 0.5));
+    }
+}
+
+double VerletList::imageDistance(const FrameBox& box, const double* ds, const int* range) {
+    const double* h = box.matrix;
+    double min_distance2 = -1;
+    for (int i = -range[0]; i <= range[0]; i++) {
+        for (int j = -range[1]; j <= range[1]; j++) {
+            for (int k = -range[2]; k <= range[2]; k++) {
+                double s[3] = {ds[0] + i, ds[1] + j, ds[2] + k};
+                double dx = h[0] * s[0] + h[1] * s[1] + h[2] * s[2];
+                double dy = h[3] * s[0] + h[4] * s[1] + h[5] * s[2];
+                double dz = h[6] * s[0] + h[7] * s[1] + h[8] * s[2];
+                double distance2 = dx * dx + dy * dy + dz * dz;
+                if (min_distance2 < 0 || distance2 < min_distance2) {
+                    min_distance2 = distance2;
+                }
+            }
+        }
+    }
+    return sqrt(min_distance2);
+}
+
+void VerletList::trackAtoms(const std::vector<int>& atoms_A, const std::vector<int>& atoms_B) {
+    tracked_.clear();
+    std::merge(atoms_A.begin(), atoms_A.end(), atoms_B.begin(), atoms_B.end(), std::back_inserter(tracked_));
+    tracked_.erase(std::unique(tracked_.begin(), tracked_.end()), tracked_.end());
+}
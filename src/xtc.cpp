@@ -0,0 +1,502 @@
+/**
+ * @file xtc.cpp
+ * @brief GROMACS XTC trajectory reading
+ *
+ * A self contained decoder of the xdr3dfcoor coordinate compression, following
+ * the reference implementation bit for bit, so decoded coordinates are identical
+ * to those of libxdrfile. Frames are located once by hopping over the frame
+ * headers, the offsets double as the frame index, and decoded in parallel.
+ */
+
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include "topology.h"
+#include "frame_index.h"
+#include "xtc.h"
+#include "system.h"
+
+namespace {
+
+const int XTC_MAGIC = 1995;
+const int XTC_MAGIC_LARGE = 2023;          // 64 bit byte count of the compressed coordinates
+const size_t HEADER_SIZE = 52;             // magic, natoms, step, time, 9 box floats
+
+// integer sizes the small differences of runs are packed with
+const int MAGIC_INTS[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
+    80, 101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290,
+    1625, 2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003,
+    16384, 20642, 26007, 32768, 41285, 52015, 65536, 82570, 104031,
+    131072, 165140, 208063, 262144, 330280, 416127, 524287, 660561,
+    832255, 1048576, 1321122, 1664510, 2097152, 2642245, 3329021,
+    4194304, 5284491, 6658042, 8388607, 10568983, 13316085, 16777216};
+const int FIRST_IDX = 9;
+const int LAST_IDX = sizeof(MAGIC_INTS) / sizeof(*MAGIC_INTS);
+
+uint32_t readUInt(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+}
+
+int32_t readInt(const char* p) {
+    return static_cast<int32_t>(readUInt(p));
+}
+
+float readFloat(const char* p) {
+    uint32_t bits = readUInt(p);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Reads the bits of the compressed coordinates, most significant first
+ */
+class BitReader {
+public:
+    BitReader(const unsigned char* data, size_t size) : data_(data), size_(size) {}
+
+    unsigned int receiveBits(int nbits) {
+        uint32_t mask = static_cast<uint32_t>((uint64_t(1) << nbits) - 1);
+        uint32_t num = 0;
+        while (nbits >= 8) {
+            last_byte_ = (last_byte_ << 8) | nextByte();
+            num |= (last_byte_ >> last_bits_) << (nbits - 8);
+            nbits -= 8;
+        }
+        if (nbits > 0) {
+            if (last_bits_ < static_cast<unsigned int>(nbits)) {
+                last_bits_ += 8;
+                last_byte_ = (last_byte_ << 8) | nextByte();
+            }
+            last_bits_ -= nbits;
+            num |= (last_byte_ >> last_bits_) & ((1u << nbits) - 1);
+        }
+        return num & mask;
+    }
+
+    /**
+     * @brief Reads three integers packed in nbits bits in mixed radix of sizes
+     */
+    void receiveInts(int nbits, const unsigned int sizes[3], int nums[3]) {
+        unsigned int bytes[32];
+        int nbytes = 0;
+        bytes[1] = bytes[2] = bytes[3] = 0;
+        if (nbits > 32 * 8) {
+            throw std::runtime_error("Corrupt XTC coordinate packing.");
+        }
+        while (nbits > 8) {
+            bytes[nbytes++] = receiveBits(8);
+            nbits -= 8;
+        }
+        if (nbits > 0) {
+            bytes[nbytes++] = receiveBits(nbits);
+        }
+        for (int i = 2; i > 0; i--) {
+            unsigned int num = 0;
+            for (int j = nbytes - 1; j >= 0; j--) {
+                num = (num << 8) | bytes[j];
+                unsigned int quotient = num / sizes[i];
+                bytes[j] = quotient;
+                num -= quotient * sizes[i];
+            }
+            nums[i] = static_cast<int>(num);
+        }
+        nums[0] = static_cast<int>(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24));
+    }
+
+private:
+    const unsigned char* data_;
+    size_t size_;
+    size_t count_{0};
+    unsigned int last_bits_{0};
+    uint32_t last_byte_{0};
+
+    unsigned int nextByte() {
+        if (count_ >= size_) {
+            throw std::runtime_error("Compressed XTC coordinates end early.");
+        }
+        return data_[count_++];
+    }
+};
+
+int sizeOfInt(unsigned int size) {
+    uint64_t num = 1;
+    int nbits = 0;
+    while (size >= num && nbits < 32) {
+        nbits++;
+        num <<= 1;
+    }
+    return nbits;
+}
+
+int sizeOfInts(const unsigned int sizes[3]) {
+    unsigned int bytes[32];
+    unsigned int nbytes = 1;
+    bytes[0] = 1;
+    for (int i = 0; i < 3; i++) {
+        unsigned int carry = 0;
+        unsigned int k = 0;
+        for (; k < nbytes; k++) {
+            carry = bytes[k] * sizes[i] + carry;
+            bytes[k] = carry & 0xff;
+            carry >>= 8;
+        }
+        while (carry != 0) {
+            bytes[k++] = carry & 0xff;
+            carry >>= 8;
+        }
+        nbytes = k;
+    }
+    int nbits = 0;
+    unsigned int num = 1;
+    nbytes--;
+    while (bytes[nbytes] >= num) {
+        nbits++;
+        num *= 2;
+    }
+    return nbits + nbytes * 8;
+}
+
+/**
+ * @brief Decodes natoms xdr3dfcoor compressed coordinates
+ *
+ * @param[in] p Start of the precision field
+ * @param[in] large True for the 64 bit byte count of XTC_MAGIC_LARGE frames
+ * @param[out] out natoms * 3 coordinates
+ */
+void decompressCoords(const char* p, const char* end, bool large, int natoms, float* out) {
+    if (end - p < 36 + (large ? 8 : 4)) {
+        throw std::runtime_error("XTC frame is truncated.");
+    }
+    float precision = readFloat(p);
+    int minint[3], maxint[3];
+    unsigned int sizeint[3], bitsizeint[3] = {0, 0, 0};
+    for (int k = 0; k < 3; k++) {
+        minint[k] = readInt(p + 4 + 4 * k);
+        maxint[k] = readInt(p + 16 + 4 * k);
+        sizeint[k] = static_cast<unsigned int>(maxint[k]) - static_cast<unsigned int>(minint[k]) + 1;
+    }
+
+    // ranges above 2^24 are stored per dimension, smaller ones packed together
+    int bitsize = 0;
+    if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff) {
+        for (int k = 0; k < 3; k++) {
+            bitsizeint[k] = sizeOfInt(sizeint[k]);
+        }
+    } else {
+        bitsize = sizeOfInts(sizeint);
+    }
+
+    int smallidx = readInt(p + 28);
+    if (smallidx < FIRST_IDX || smallidx >= LAST_IDX) {
+        throw std::runtime_error("Corrupt XTC coordinate packing.");
+    }
+    int smaller = MAGIC_INTS[std::max(FIRST_IDX, smallidx - 1)] / 2;
+    int smallnum = MAGIC_INTS[smallidx] / 2;
+    unsigned int sizesmall[3];
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = MAGIC_INTS[smallidx];
+
+    uint64_t nbytes;
+    const char* data;
+    if (large) {
+        nbytes = (uint64_t(readUInt(p + 32)) << 32) | readUInt(p + 36);
+        data = p + 40;
+    } else {
+        nbytes = readUInt(p + 32);
+        data = p + 36;
+    }
+    if (nbytes > static_cast<uint64_t>(end - data)) {
+        throw std::runtime_error("XTC frame is truncated.");
+    }
+    BitReader bits(reinterpret_cast<const unsigned char*>(data), nbytes);
+
+    float inv_precision = static_cast<float>(1.0 / precision);
+    int i = 0;
+    int run = 0;
+    int thiscoord[3], prevcoord[3];
+    while (i < natoms) {
+        if (bitsize == 0) {
+            for (int k = 0; k < 3; k++) {
+                thiscoord[k] = static_cast<int>(bits.receiveBits(bitsizeint[k]));
+            }
+        } else {
+            bits.receiveInts(bitsize, sizeint, thiscoord);
+        }
+        i++;
+        for (int k = 0; k < 3; k++) {
+            thiscoord[k] += minint[k];
+            prevcoord[k] = thiscoord[k];
+        }
+
+        // a set flag announces a new run length and a change of the small size
+        int is_smaller = 0;
+        if (bits.receiveBits(1) == 1) {
+            run = static_cast<int>(bits.receiveBits(5));
+            is_smaller = run % 3;
+            run -= is_smaller;
+            is_smaller--;
+        }
+        if (run > 0) {
+            if (i + run / 3 > natoms) {
+                throw std::runtime_error("Corrupt XTC coordinate packing.");
+            }
+            for (int k = 0; k < run; k += 3) {
+                bits.receiveInts(smallidx, sizesmall, thiscoord);
+                i++;
+                for (int d = 0; d < 3; d++) {
+                    thiscoord[d] += prevcoord[d] - smallnum;
+                }
+                if (k == 0) {
+                    // the first two atoms of a run are stored swapped, which compresses water better
+                    std::swap_ranges(thiscoord, thiscoord + 3, prevcoord);
+                    for (int d = 0; d < 3; d++) {
+                        *out++ = static_cast<float>(prevcoord[d]) * inv_precision;
+                    }
+                } else {
+                    std::copy(thiscoord, thiscoord + 3, prevcoord);
+                }
+                for (int d = 0; d < 3; d++) {
+                    *out++ = static_cast<float>(thiscoord[d]) * inv_precision;
+                }
+            }
+        } else {
+            for (int d = 0; d < 3; d++) {
+                *out++ = static_cast<float>(thiscoord[d]) * inv_precision;
+            }
+        }
+
+        smallidx += is_smaller;
+        if (smallidx < FIRST_IDX || smallidx >= LAST_IDX) {
+            throw std::runtime_error("Corrupt XTC coordinate packing.");
+        }
+        if (is_smaller < 0) {
+            smallnum = smaller;
+            smaller = smallidx > FIRST_IDX ? MAGIC_INTS[smallidx - 1] / 2 : 0;
+        } else if (is_smaller > 0) {
+            smaller = smallnum;
+            smallnum = MAGIC_INTS[smallidx] / 2;
+        }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = MAGIC_INTS[smallidx];
+    }
+}
+
+} // namespace
+
+XTCFile::XTCFile(const std::string& filename, bool sequential) : map_(filename, sequential) {
+    if (map_.size() < HEADER_SIZE) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+    int magic = readInt(map_.data());
+    if (magic != XTC_MAGIC && magic != XTC_MAGIC_LARGE) {
+        throw std::runtime_error("File " + filename + " is not an XTC trajectory.");
+    }
+    natoms_ = readInt(map_.data() + 4);
+    if (natoms_ <= 0) {
+        throw std::runtime_error("Invalid number of atoms in trajectory file header.");
+    }
+}
+
+size_t XTCFile::frameEnd(size_t offset) const {
+    size_t remaining = map_.size() - std::min(offset, map_.size());
+    if (remaining < HEADER_SIZE + 4) {
+        return 0;
+    }
+    const char* p = map_.data() + offset;
+    int magic = readInt(p);
+    if ((magic != XTC_MAGIC && magic != XTC_MAGIC_LARGE) || readInt(p + 4) != natoms_) {
+        throw std::runtime_error("Corrupt XTC frame at byte " + std::to_string(offset) + ".");
+    }
+
+    size_t size = HEADER_SIZE + 4;
+    int lsize = readInt(p + HEADER_SIZE);
+    if (lsize <= 9) {
+        size += 12 * static_cast<size_t>(std::max(lsize, 0));
+    } else {
+        size_t count_size = magic == XTC_MAGIC_LARGE ? 8 : 4;
+        if (remaining < size + 32 + count_size) {
+            return 0;
+        }
+        uint64_t nbytes = count_size == 8 ? (uint64_t(readUInt(p + size + 32)) << 32) | readUInt(p + size + 36)
+                                          : readUInt(p + size + 32);
+        size += 32 + count_size + (nbytes + 3) / 4 * 4;
+    }
+    return size <= remaining ? offset + size : 0;
+}
+
+bool XTCFile::readFrame(size_t offset, const std::vector<int>& indices, double* coords, double* box) const {
+    size_t end = frameEnd(offset);
+    if (end == 0) {
+        throw std::runtime_error("XTC frame at byte " + std::to_string(offset) + " is truncated.");
+    }
+    const char* p = map_.data() + offset;
+
+    // box vectors are the rows of the stored matrix, the columns of the box matrix
+    double vectors[9];
+    for (int k = 0; k < 9; k++) {
+        vectors[k] = readFloat(p + 16 + 4 * k);
+    }
+    bool has_box = true;
+    for (int v = 0; v < 3; v++) {
+        has_box = has_box && (vectors[3 * v] != 0 || vectors[3 * v + 1] != 0 || vectors[3 * v + 2] != 0);
+    }
+    if (box && has_box) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                box[r * 3 + c] = vectors[c * 3 + r];
+            }
+        }
+    }
+
+    int lsize = readInt(p + HEADER_SIZE);
+    if (lsize != natoms_) {
+        throw std::runtime_error("XTC frame at byte " + std::to_string(offset)
+                                 + " has a different number of atoms than the first frame.");
+    }
+    std::vector<float> frame_coords(static_cast<size_t>(natoms_) * 3);
+    const char* data = p + HEADER_SIZE + 4;
+    if (lsize <= 9) {
+        for (size_t k = 0; k < frame_coords.size(); k++) {
+            frame_coords[k] = readFloat(data + 4 * k);
+        }
+    } else {
+        decompressCoords(data, map_.data() + end, readInt(p) == XTC_MAGIC_LARGE, natoms_, frame_coords.data());
+    }
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        for (int k = 0; k < 3; k++) {
+            coords[i * 3 + k] = frame_coords[static_cast<size_t>(indices[i]) * 3 + k];
+        }
+    }
+    return has_box;
+}
+
+void FrameIndex::buildXTC(const std::string& trajectory_file_name) {
+    XTCFile file(trajectory_file_name);
+    natoms = file.natoms();
+    offsets.clear();
+
+    // only the headers are read, the compressed coordinates are hopped over
+    size_t offset = 0;
+    while (offset < file.size()) {
+        size_t end = file.frameEnd(offset);
+        if (end == 0) {
+            std::cerr << "Truncated frame " << offsets.size() << " at end of trajectory is ignored." << std::endl;
+            break;
+        }
+        offsets.push_back(offset);
+        offset = end;
+    }
+    if (offsets.empty()) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+}
+
+XTCFrameSource::XTCFrameSource(const std::string& filename, const std::vector<std::string>& names,
+                               const FrameSelection& selection, const AtomSelection& atom_selection)
+    : file_(filename), selection_(selection) {
+    if (static_cast<int>(names.size()) != file_.natoms()) {
+        throw std::runtime_error("Topology has " + std::to_string(names.size()) + " atoms, XTC trajectory has "
+                                 + std::to_string(file_.natoms()) + ".");
+    }
+    atom_selection.slots(names, indices_);
+    for (int index : indices_) {
+        names_.push_back(names[index]);
+    }
+}
+
+bool XTCFrameSource::readFrame(double* coords, double* box) {
+    auto start = std::chrono::steady_clock::now();
+
+    // frames outside the selection are hopped over by their headers
+    while (!selection_.contains(frame_) && !selection_.finished(frame_)) {
+        size_t end = file_.frameEnd(offset_);
+        if (end == 0) {
+            return false;
+        }
+        offset_ = end;
+        frame_++;
+    }
+    if (selection_.finished(frame_) || offset_ >= file_.size()) {
+        return false;
+    }
+
+    size_t end = file_.frameEnd(offset_);
+    if (end == 0) {
+        std::cerr << "Truncated frame " << frame_ << " at end of trajectory is ignored." << std::endl;
+        return false;
+    }
+    if (!file_.readFrame(offset_, indices_, coords, box) && box) {
+        throw std::runtime_error("Frame " + std::to_string(frame_) + " of the XTC trajectory has no box.");
+    }
+    offset_ = end;
+    frame_++;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    read_seconds_ += elapsed.count();
+    return true;
+}
+
+void System::readXTC(const std::string& filename, const std::string& topology_file_name,
+                     const FrameIndex& index, int threads) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+    if (topology_file_name.empty()) {
+        throw std::runtime_error("XTC trajectories need a topology_input naming the atoms.");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "Reading XTC trajectory file: " << filename << std::endl;
+    std::vector<std::string> trajectory_atoms = readAtomNames(topology_file_name);
+    XTCFile xtc(filename);
+    if (static_cast<int>(trajectory_atoms.size()) != xtc.natoms()) {
+        throw std::runtime_error("Topology has " + std::to_string(trajectory_atoms.size())
+                                 + " atoms, XTC trajectory has " + std::to_string(xtc.natoms()) + ".");
+    }
+
+    std::vector<uint64_t> starts = selection.apply(index.offsets);
+    if (starts.empty()) {
+        throw std::logic_error("No frames in the requested range, the trajectory has "
+                               + std::to_string(index.offsets.size()) + " frames.");
+    }
+
+    nframes = static_cast<int>(starts.size());
+    setupAtoms(trajectory_atoms);
+    xyz_boxes.clear();
+    box_matrices.assign(static_cast<size_t>(nframes) * 9, 0.0);
+    xyz_box_error.clear();
+
+    // frames are independent once their offsets are known
+    std::vector<std::string> errors(nframes);
+    std::vector<char> has_box(nframes);
+    #pragma omp parallel for schedule(dynamic, 4) num_threads(std::max(1, threads))
+    for (int i = 0; i < nframes; i++) {
+        try {
+            double* frame_coords = frameBuffer(i);
+            has_box[i] = xtc.readFrame(starts[i], atom_indices, frame_coords, &box_matrices[static_cast<size_t>(i) * 9]);
+            storeFrame(i, frame_coords);
+        } catch (const std::exception& e) {
+            errors[i] = "Frame " + std::to_string(selection.trajectoryFrame(i)) + ": " + e.what();
+        }
+    }
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+    for (int i = 0; i < nframes; i++) {
+        if (!has_box[i]) {
+            xyz_box_error = "Frame " + std::to_string(selection.trajectoryFrame(i)) + " of the XTC trajectory has no box.";
+            box_matrices.clear();
+            break;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reportThroughput(xtc.size(), elapsed.count());
+    std::cout << "Trajectory file parsed successfully!" << std::endl;
+}
@@ -0,0 +1,720 @@
+/**
+ * @file xyz.cpp
+ * @brief Memory mapped xyz trajectory parsing
+ *
+ * Scans the mapped trajectory bytes directly. Numbers are parsed in place with
+ * std::from_chars, atom names of later frames are compared without copies, so
+ * no heap memory is touched per line. Since every frame spans natoms + 2 lines,
+ * frames can also be located by counting newlines and parsed concurrently.
+ * XYZFrameSource streams the same format one frame at a time.
+ */
+
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "mapped_file.h"
+#include "text_scan.h"
+#include "extxyz.h"
+#include "frame_source.h"
+#include "frame_index.h"
+#include "system.h"
+
+namespace {
+
+/**
+ * @brief Parses the atom lines of one frame
+ *
+ * Lines of atoms dropped by the atom selection are skipped without being parsed.
+ * Atom lines of extended xyz files are read column by column as laid out in columns,
+ * numeric properties are stored at row property_row + slot of their values.
+ * @param[in] p Start of the first atom line
+ * @param[in] end End of the mapped trajectory
+ * @param[in] nlines Number of atom lines in the frame
+ * @param[in] species Species of the stored atoms, checked against the frame
+ * @param[in] slots Stored atom index of each line, -1 if dropped, nullptr stores all
+ * @param[out] frame_coords Coordinates of the stored atoms of this frame
+ * @param[in] frame Frame index used in messages
+ * @param[out] mismatches Lines whose atom name differs from the stored species are appended
+ * @param[in] columns Layout of the atom lines
+ * @param[out] properties Extra per-atom columns to store, or nullptr
+ * @param[in] property_row Row of the first atom of this frame in the property values
+ * @return Position after the frame, nullptr if the frame is truncated
+ */
+const char* parseFrameAtoms(const char* p, const char* end, int nlines, const SpeciesTable& species,
+                            const int* slots, double* frame_coords, int frame, std::vector<int>& mismatches,
+                            const XYZColumns& columns = XYZColumns(),
+                            std::vector<AtomProperty>* properties = nullptr, size_t property_row = 0) {
+    bool plain = columns.plain() && (!properties || properties->empty());
+    int last_column = std::max(columns.species, columns.pos + 2);
+    if (properties && !properties->empty()) {
+        last_column = columns.ncolumns - 1;
+    }
+
+    for (int j = 0; j < nlines; j++) {
+        if (p >= end) {
+            return nullptr;
+        }
+        const char* eol = textscan::lineEnd(p, end);
+        int slot = slots ? slots[j] : j;
+        if (slot < 0) {
+            p = eol < end ? eol + 1 : end;
+            continue;
+        }
+
+        const char* name = nullptr;
+        size_t length = 0;
+        if (plain) {
+            p = textscan::parseToken(p, eol, name, length);
+            for (int k = 0; k < 3 && p; k++) {
+                p = textscan::parseDouble(p, eol, frame_coords[slot * 3 + k]);
+            }
+        } else {
+            for (int col = 0; col <= last_column && p; col++) {
+                const char* token;
+                size_t token_length;
+                p = textscan::parseToken(p, eol, token, token_length);
+                if (token_length == 0) {
+                    p = nullptr;
+                } else if (col == columns.species) {
+                    name = token;
+                    length = token_length;
+                } else if (col >= columns.pos && col < columns.pos + 3) {
+                    double& value = frame_coords[slot * 3 + col - columns.pos];
+                    p = textscan::parseDouble(token, token + token_length, value) ? p : nullptr;
+                } else if (properties) {
+                    for (AtomProperty& property : *properties) {
+                        if (col >= property.column && col < property.column + property.size) {
+                            double& value = property.values[(property_row + slot) * property.size + col - property.column];
+                            p = textscan::parseDouble(token, token + token_length, value) ? p : nullptr;
+                        }
+                    }
+                }
+            }
+        }
+        if (!p) {
+            throw std::runtime_error("Cannot read coordinates of atom " + std::to_string(j)
+                                     + " in frame " + std::to_string(frame) + ".");
+        }
+
+        if (!species.matches(slot, name, length)) {
+            mismatches.push_back(j);
+        }
+
+        p = eol < end ? eol + 1 : end;
+    }
+    return p;
+}
+
+/**
+ * @brief Warns about the atom lines of a frame whose names differ from the first frame
+ */
+void reportNameMismatches(int frame, const std::vector<int>& mismatches) {
+    for (int j : mismatches) {
+        std::cerr << "Frame " << frame << " has different atom name at index " << j << std::endl;
+    }
+}
+
+/**
+ * @brief Reads the atom names of the nlines atom lines starting at p
+ *
+ * @param[in] column Column of the atom names, the species column of extended xyz
+ * @return false if the frame is truncated
+ */
+bool scanAtomNames(const char* p, const char* end, int nlines, std::vector<std::string>& names, int column = 0) {
+    names.resize(nlines);
+    for (int j = 0; j < nlines; j++) {
+        if (p >= end) {
+            return false;
+        }
+        const char* name = nullptr;
+        size_t length = 0;
+        const char* q = p;
+        for (int col = 0; col <= column; col++) {
+            q = textscan::parseToken(q, end, name, length);
+        }
+        names[j].assign(name, length);
+        p = textscan::nextLine(p, end);
+    }
+    return true;
+}
+
+/**
+ * @brief Reads up to 7 numbers from a comment line, returns how many were read
+ */
+int scanBoxValues(const char* p, const char* eol, double* values) {
+    int count = 0;
+    while (count < 7 && (p = textscan::parseDouble(p, eol, values[count]))) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Reads the layout of an extended xyz trajectory from its first comment line
+ *
+ * @return true if the comment line has a Lattice key, every frame then needs one
+ */
+bool scanExtendedHeader(const char* p, const char* eol, XYZColumns& columns, std::vector<AtomProperty>& properties) {
+    double matrix[9];
+    parseProperties(p, eol, columns, properties);
+    return parseLattice(p, eol, matrix);
+}
+
+/**
+ * @brief Reads the Lattice key of the comment line of frame into a box matrix
+ */
+void readLattice(const char* p, const char* eol, int frame, double* matrix) {
+    if (!parseLattice(p, eol, matrix)) {
+        throw std::runtime_error("Frame " + std::to_string(frame) + " has no Lattice in its comment line.");
+    }
+}
+
+} // namespace
+
+std::vector<size_t> locateXYZFrames(const char* begin, const char* end, long lines_per_frame, int threads) {
+    size_t size = static_cast<size_t>(end - begin);
+    int nchunks = std::max(1, threads);
+    std::vector<size_t> counts(nchunks, 0);
+    std::vector<std::vector<size_t>> chunk_starts(nchunks);
+
+    #pragma omp parallel for num_threads(threads)
+    for (int c = 0; c < nchunks; c++) {
+        const char* first = begin + size * c / nchunks;
+        const char* last = begin + size * (c + 1) / nchunks;
+        counts[c] = std::count(first, last, '\n');
+    }
+
+    std::vector<size_t> newlines_before(nchunks, 0);
+    for (int c = 1; c < nchunks; c++) {
+        newlines_before[c] = newlines_before[c - 1] + counts[c - 1];
+    }
+
+    #pragma omp parallel for num_threads(threads)
+    for (int c = 0; c < nchunks; c++) {
+        const char* p = begin + size * c / nchunks;
+        const char* last = begin + size * (c + 1) / nchunks;
+        size_t line = newlines_before[c];
+        if (c == 0) {
+            chunk_starts[c].push_back(0);
+        }
+        while ((p = static_cast<const char*>(memchr(p, '\n', last - p)))) {
+            line++;
+            p++;
+            if (line % lines_per_frame == 0 && p < end) {
+                chunk_starts[c].push_back(static_cast<size_t>(p - begin));
+            }
+        }
+    }
+
+    // only frames with all of their lines present are complete
+    size_t total_newlines = newlines_before[nchunks - 1] + counts[nchunks - 1];
+    size_t total_lines = total_newlines + ((size > 0 && end[-1] != '\n') ? 1 : 0);
+    size_t complete = total_lines / lines_per_frame;
+
+    std::vector<size_t> starts;
+    starts.reserve(complete);
+    for (int c = 0; c < nchunks && starts.size() < complete; c++) {
+        for (size_t offset : chunk_starts[c]) {
+            if (starts.size() == complete) {
+                break;
+            }
+            starts.push_back(offset);
+        }
+    }
+    return starts;
+}
+
+void System::readXYZMapped(const std::string &trajectory_file_name) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+
+    if (trajectory_file_name.empty()) {
+        throw std::runtime_error("Trajectory file is not specified, please include an xyz file.");
+    }
+
+    std::cout << "Parsing trajectory file: " + trajectory_file_name << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(trajectory_file_name);
+    const char* p = file.begin();
+    const char* end = file.end();
+
+    int xyz_box_format = -1;
+    int frame = 0;
+    double box_values[7];
+    std::vector<std::string> trajectory_atoms;
+    XYZColumns columns;
+    bool lattice = false;
+    xyz_boxes.clear();
+    xyz_box_error.clear();
+    box_matrices.clear();
+    frame_offsets.clear();
+
+    while (p < end) {
+        const char* eol = textscan::lineEnd(p, end);
+        if (textscan::blankLine(p, eol)) {
+            p = eol < end ? eol + 1 : end;
+            continue;
+        }
+
+        size_t frame_offset = static_cast<size_t>(p - file.begin());
+        int frame_natoms = 0;
+        textscan::parseInteger(p, eol, frame_natoms);
+
+        // frames outside the selection are skipped by counting lines only
+        if (selection.finished(frame)) {
+            break;
+        }
+        if (!selection.contains(frame)) {
+            p = textscan::skipLines(p, end, frame_natoms + 2L);
+            frame++;
+            continue;
+        }
+
+        if (nframes == 0) {
+            if (frame_natoms <= 0) {
+                throw std::runtime_error("Invalid number of atoms in trajectory file header.");
+            }
+        } else if (frame_natoms != natoms_total) {
+            throw std::runtime_error("Frame " + std::to_string(nframes)
+                                     + " has a different number of atoms than the first frame.");
+        }
+
+        // comment line carries the box of this frame, if any
+        p = eol < end ? eol + 1 : end;
+        if (p >= end) {
+            break;
+        }
+
+        // the first frame decides which atoms are stored and how its lines are laid out
+        eol = textscan::lineEnd(p, end);
+        if (nframes == 0) {
+            lattice = scanExtendedHeader(p, eol, columns, atom_properties);
+            if (!scanAtomNames(textscan::nextLine(p, end), end, frame_natoms, trajectory_atoms, columns.species)) {
+                break;
+            }
+            setupAtoms(trajectory_atoms);
+        }
+        if (lattice) {
+            double matrix[9];
+            readLattice(p, eol, frame, matrix);
+            box_matrices.insert(box_matrices.end(), matrix, matrix + 9);
+        } else if (xyz_box_error.empty()) {
+            try {
+                int count = scanBoxValues(p, eol, box_values);
+                size_t offset = xyz_boxes.size();
+                xyz_boxes.resize(offset + 6);
+                expandBoxParams(box_values, count, xyz_box_format, xyz_boxes.data() + offset);
+            } catch (const std::exception& e) {
+                xyz_box_error = "Frame " + std::to_string(nframes) + ": " + e.what();
+                xyz_boxes.clear();
+            }
+        }
+        p = eol < end ? eol + 1 : end;
+
+        growTrajectoryMemory(nframes + 1);
+        double* frame_coords = frameBuffer(nframes);
+        for (AtomProperty& property : atom_properties) {
+            property.values.resize(static_cast<size_t>(nframes + 1) * natoms * property.size);
+        }
+        std::vector<int> mismatches;
+        p = parseFrameAtoms(p, end, natoms_total, species, atom_slots.data(), frame_coords, nframes, mismatches,
+                            columns, &atom_properties, static_cast<size_t>(nframes) * natoms);
+        reportNameMismatches(nframes, mismatches);
+
+        if (!p) {
+            std::cerr << "Truncated frame " << nframes << " at end of trajectory is ignored." << std::endl;
+            break;
+        }
+        storeFrame(nframes, frame_coords);
+        frame_offsets.push_back(frame_offset);
+        nframes++;
+        frame++;
+    }
+
+    if (nframes == 0) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+    box_matrices.resize(lattice ? static_cast<size_t>(nframes) * 9 : 0);
+    for (AtomProperty& property : atom_properties) {
+        property.values.resize(static_cast<size_t>(nframes) * natoms * property.size);
+    }
+    if (!xyz_box_error.empty() || lattice) {
+        xyz_boxes.clear();
+    } else {
+        xyz_boxes.resize(static_cast<size_t>(nframes) * 6);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reportThroughput(file.size(), elapsed.count());
+    reportAtomProperties();
+    std::cout << "Trajectory file parsed successfully!" << std::endl;
+}
+
+void System::readXYZParallel(const std::string &trajectory_file_name, int threads) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+
+    if (trajectory_file_name.empty()) {
+        throw std::runtime_error("Trajectory file is not specified, please include an xyz file.");
+    }
+
+    std::cout << "Parsing trajectory file: " + trajectory_file_name
+              << " with " << threads << " threads" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(trajectory_file_name);
+    const char* begin = file.begin();
+    const char* end = file.end();
+
+    int frame_natoms = 0;
+    textscan::parseInteger(begin, textscan::lineEnd(begin, end), frame_natoms);
+    if (frame_natoms <= 0) {
+        throw std::runtime_error("Invalid number of atoms in trajectory file header.");
+    }
+
+    frame_offsets = locateXYZFrames(begin, end, frame_natoms + 2L, threads);
+    if (selection.active()) {
+        std::vector<size_t> starts = selection.apply(frame_offsets);
+        frame_offsets.clear();
+        parseXYZFrames(file, starts, threads);
+    } else {
+        parseXYZFrames(file, frame_offsets, threads);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reportThroughput(file.size(), elapsed.count());
+    std::cout << "Trajectory file parsed successfully!" << std::endl;
+}
+
+void System::readXYZIndexed(const std::string &trajectory_file_name, const FrameIndex& index, int threads) {
+    if (!species.empty() || coords) {
+        throw std::logic_error("Coordinates already in System instance.");
+    }
+
+    std::vector<size_t> starts = selection.apply(
+        std::vector<size_t>(index.offsets.begin(), index.offsets.end()));
+    if (starts.empty()) {
+        throw std::logic_error("No frames in the requested range, the trajectory has "
+                               + std::to_string(index.offsets.size()) + " frames.");
+    }
+
+    std::cout << "Parsing " << starts.size() << " selected frames of trajectory file: "
+              << trajectory_file_name << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(trajectory_file_name);
+    for (size_t offset : starts) {
+        if (offset >= file.size()) {
+            throw std::runtime_error("Frame index does not match trajectory file " + trajectory_file_name);
+        }
+    }
+    parseXYZFrames(file, starts, threads);
+
+    // only the bytes of the selected frames were touched
+    size_t bytes = 0;
+    for (int i = 0; i < nframes; i++) {
+        size_t frame = static_cast<size_t>(selection.trajectoryFrame(i));
+        bytes += (frame + 1 < index.offsets.size() ? index.offsets[frame + 1] : file.size()) - index.offsets[frame];
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reportThroughput(bytes, elapsed.count());
+    std::cout << "Trajectory file parsed successfully!" << std::endl;
+}
+
+void System::parseXYZFrames(const MappedFile& file, const std::vector<size_t>& starts, int threads) {
+    const char* begin = file.begin();
+    const char* end = file.end();
+
+    if (starts.empty()) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+
+    // the first frame decides which atoms are stored
+    const char* first = begin + starts[0];
+    int frame_natoms = 0;
+    textscan::parseInteger(first, textscan::lineEnd(first, end), frame_natoms);
+    std::vector<std::string> trajectory_atoms;
+    if (frame_natoms <= 0) {
+        throw std::runtime_error("Invalid number of atoms in trajectory file header.");
+    }
+    XYZColumns columns;
+    const char* comment = textscan::nextLine(first, end);
+    bool lattice = scanExtendedHeader(comment, textscan::lineEnd(comment, end), columns, atom_properties);
+    if (!scanAtomNames(textscan::skipLines(first, end, 2), end, frame_natoms, trajectory_atoms, columns.species)) {
+        throw std::runtime_error("Frame " + std::to_string(selection.trajectoryFrame(0)) + " is truncated.");
+    }
+
+    nframes = static_cast<int>(starts.size());
+    setupAtoms(trajectory_atoms);
+    box_matrices.assign(lattice ? static_cast<size_t>(nframes) * 9 : 0, 0.0);
+    for (AtomProperty& property : atom_properties) {
+        property.values.assign(static_cast<size_t>(nframes) * natoms * property.size, 0.0);
+    }
+
+    // frames are independent, box values are validated in frame order afterwards
+    std::vector<double> box_values(static_cast<size_t>(nframes) * 7);
+    std::vector<int> box_counts(nframes);
+    std::vector<std::string> errors(nframes);
+    std::vector<std::vector<int>> mismatches(nframes);
+
+    auto parseFrame = [&](int frame) {
+        const char* p = begin + starts[frame];
+        const char* eol = textscan::lineEnd(p, end);
+        int frame_natoms = 0;
+        textscan::parseInteger(p, eol, frame_natoms);
+        if (frame_natoms != natoms_total) {
+            throw std::runtime_error("Frame " + std::to_string(selection.trajectoryFrame(frame))
+                                     + " has a different number of atoms than the first frame.");
+        }
+
+        p = textscan::nextLine(p, end);
+        eol = textscan::lineEnd(p, end);
+        if (lattice) {
+            readLattice(p, eol, selection.trajectoryFrame(frame), &box_matrices[static_cast<size_t>(frame) * 9]);
+        } else {
+            box_counts[frame] = scanBoxValues(p, eol, &box_values[static_cast<size_t>(frame) * 7]);
+        }
+
+        double* frame_coords = frameBuffer(frame);
+        if (!parseFrameAtoms(textscan::nextLine(p, end), end, natoms_total, species, atom_slots.data(),
+                             frame_coords, selection.trajectoryFrame(frame), mismatches[frame],
+                             columns, &atom_properties, static_cast<size_t>(frame) * natoms)) {
+            throw std::runtime_error("Frame " + std::to_string(selection.trajectoryFrame(frame)) + " is truncated.");
+        }
+        storeFrame(frame, frame_coords);
+    };
+
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(threads)
+    for (int frame = 0; frame < nframes; frame++) {
+        try {
+            parseFrame(frame);
+        } catch (const std::exception& e) {
+            errors[frame] = e.what();
+        }
+    }
+
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+    for (int frame = 0; frame < nframes; frame++) {
+        reportNameMismatches(selection.trajectoryFrame(frame), mismatches[frame]);
+    }
+
+    reportAtomProperties();
+    xyz_box_error.clear();
+    if (lattice) {
+        xyz_boxes.clear();
+        return;
+    }
+
+    int xyz_box_format = -1;
+    xyz_boxes.resize(static_cast<size_t>(nframes) * 6);
+    for (int frame = 0; frame < nframes; frame++) {
+        try {
+            expandBoxParams(&box_values[static_cast<size_t>(frame) * 7], box_counts[frame],
+                            xyz_box_format, &xyz_boxes[static_cast<size_t>(frame) * 6]);
+        } catch (const std::exception& e) {
+            xyz_box_error = "Frame " + std::to_string(selection.trajectoryFrame(frame)) + ": " + e.what();
+            xyz_boxes.clear();
+            break;
+        }
+    }
+}
+
+void FrameIndex::buildXYZ(const std::string& trajectory_file_name) {
+    MappedFile file(trajectory_file_name);
+    const char* p = file.begin();
+    const char* end = file.end();
+
+    // frames are skipped by counting lines, nothing but the headers is parsed
+    natoms = 0;
+    offsets.clear();
+    while (p < end) {
+        const char* eol = textscan::lineEnd(p, end);
+        if (textscan::blankLine(p, eol)) {
+            p = textscan::nextLine(p, end);
+            continue;
+        }
+
+        if (offsets.empty()) {
+            textscan::parseInteger(p, eol, natoms);
+            if (natoms <= 0) {
+                throw std::runtime_error("Invalid number of atoms in trajectory file header.");
+            }
+        }
+
+        const char* frame = p;
+        long lines = 0;
+        while (lines < natoms + 2L && p < end) {
+            p = textscan::nextLine(p, end);
+            lines++;
+        }
+        if (lines < natoms + 2L) {
+            break;
+        }
+        offsets.push_back(static_cast<uint64_t>(frame - file.begin()));
+    }
+}
+
+XYZFrameSource::XYZFrameSource(const std::string& filename, const FrameSelection& selection,
+                               const AtomSelection& atom_selection)
+    : file_(filename), selection_(selection) {
+    if (!file_.isOpen()) {
+        throw std::runtime_error("Cannot open trajectory file, please check if it exists.");
+    }
+    buffer_.resize(1 << 22);
+
+    // peek at the first frame for natoms and atom names, nothing is consumed
+    skipBlankLines();
+    const char* last;
+    if (!bufferLines(1, last)) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+    textscan::parseInteger(buffer_.data() + begin_, last, natoms_total_);
+    if (natoms_total_ <= 0) {
+        throw std::runtime_error("Invalid number of atoms in trajectory file header.");
+    }
+
+    if (!bufferLines(natoms_total_ + 2, last)) {
+        throw std::runtime_error("No complete frame found in trajectory file.");
+    }
+    // extended xyz layout and Lattice boxes are taken from the first comment line
+    const char* comment = textscan::nextLine(buffer_.data() + begin_, last);
+    std::vector<AtomProperty> properties;
+    lattice_ = scanExtendedHeader(comment, textscan::lineEnd(comment, last), columns_, properties);
+
+    std::vector<std::string> trajectory_atoms;
+    scanAtomNames(textscan::skipLines(buffer_.data() + begin_, last, 2), last, natoms_total_, trajectory_atoms,
+                  columns_.species);
+
+    slots_ = atom_selection.slots(trajectory_atoms, indices_);
+    natoms_ = static_cast<int>(indices_.size());
+    for (int index : indices_) {
+        names_.push_back(trajectory_atoms[index]);
+    }
+    species_.assign(names_);
+}
+
+XYZFrameSource::~XYZFrameSource() = default;
+
+bool XYZFrameSource::bufferLines(long nlines, const char*& last) {
+    size_t scanned = begin_;
+    long found = 0;
+
+    while (true) {
+        const char* p = buffer_.data() + scanned;
+        const char* end = buffer_.data() + end_;
+        const char* nl;
+        while (found < nlines && (nl = static_cast<const char*>(memchr(p, '\n', end - p)))) {
+            found++;
+            p = nl + 1;
+        }
+
+        if (found == nlines) {
+            last = p - 1;
+            return true;
+        }
+        if (eof_) {
+            // the last line of the file may lack its newline
+            if (found == nlines - 1 && p < end) {
+                last = end;
+                return true;
+            }
+            return false;
+        }
+
+        // keep the unread part, make room and read the next block
+        scanned = static_cast<size_t>(p - buffer_.data()) - begin_;
+        if (begin_ > 0) {
+            memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        if (end_ == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+
+        size_t bytes = file_.read(buffer_.data() + end_, buffer_.size() - end_);
+        end_ += bytes;
+        if (bytes == 0) {
+            eof_ = true;
+        }
+    }
+}
+
+void XYZFrameSource::skipBlankLines() {
+    const char* last;
+    while (bufferLines(1, last) && textscan::blankLine(buffer_.data() + begin_, last)) {
+        begin_ = std::min(static_cast<size_t>(last - buffer_.data()) + 1, end_);
+    }
+}
+
+bool XYZFrameSource::readFrame(double* coords, double* box) {
+    auto start = std::chrono::steady_clock::now();
+    skipBlankLines();
+
+    // frames outside the selection are skipped by counting lines only
+    const char* last;
+    while (!selection_.contains(frame_) && !selection_.finished(frame_)) {
+        if (!bufferLines(natoms_total_ + 2, last)) {
+            return false;
+        }
+        begin_ = std::min(static_cast<size_t>(last - buffer_.data()) + 1, end_);
+        frame_++;
+        skipBlankLines();
+    }
+    if (selection_.finished(frame_)) {
+        return false;
+    }
+
+    if (!bufferLines(natoms_total_ + 2, last)) {
+        if (begin_ < end_) {
+            std::cerr << "Truncated frame " << frame_ << " at end of trajectory is ignored." << std::endl;
+        }
+        return false;
+    }
+
+    const char* p = buffer_.data() + begin_;
+    const char* eol = textscan::lineEnd(p, last);
+    int frame_natoms = 0;
+    textscan::parseInteger(p, eol, frame_natoms);
+    if (frame_natoms != natoms_total_) {
+        throw std::runtime_error("Frame " + std::to_string(frame_)
+                                 + " has a different number of atoms than the first frame.");
+    }
+
+    // comment line carries the box of this frame
+    p = textscan::nextLine(p, last);
+    eol = textscan::lineEnd(p, last);
+    if (box && lattice_) {
+        readLattice(p, eol, frame_, box);
+    } else if (box) {
+        double box_values[7];
+        int count = scanBoxValues(p, eol, box_values);
+        try {
+            System::expandBoxParams(box_values, count, box_format_, box);
+        } catch (const std::exception& e) {
+            throw std::runtime_error("Frame " + std::to_string(frame_) + ": " + e.what());
+        }
+    }
+
+    std::vector<int> mismatches;
+    parseFrameAtoms(textscan::nextLine(p, last), last, natoms_total_, species_, slots_.data(), coords, frame_,
+                    mismatches, columns_);
+    reportNameMismatches(frame_, mismatches);
+
+    begin_ = std::min(static_cast<size_t>(last - buffer_.data()) + 1, end_);
+    frame_++;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    read_seconds_ += elapsed.count();
+    return true;
+}